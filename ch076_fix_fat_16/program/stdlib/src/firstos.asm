@@ -11,6 +11,18 @@ global firstos_start_load_process:function
 global firstos_command:function
 global firstos_get_process_arguments:function
 global firstos_exit:function
+global firstos_sync:function
+global firstos_open_directory:function
+global firstos_read_directory:function
+global firstos_close_directory:function
+global firstos_open:function
+global firstos_read:function
+global firstos_seek:function
+global firstos_stat:function
+global firstos_close:function
+global firstos_mount:function
+global firstos_unmount:function
+global firstos_write:function
 
 
 ; void print(const char* message)
@@ -106,4 +118,145 @@ firstos_exit:
     mov eax, 9 ; exit system call
     int 0x80
     pop ebp
+    ret
+
+; int firstos_sync()
+firstos_sync:
+    push ebp
+    mov ebp, esp
+    mov eax, 10 ; sync system call. write cached disk writes back
+    int 0x80
+    pop ebp
+    ret
+
+; int firstos_open_directory(const char* path)
+firstos_open_directory:
+    push ebp
+    mov ebp, esp
+    mov eax, 11 ; open directory system call
+    push dword[ebp + 8] ; "path" variable
+    int 0x80
+    add esp, 4
+    pop ebp
+    ret
+
+; int firstos_read_directory(int directory_descriptor, void* buffer, size_t size)
+firstos_read_directory:
+    push ebp
+    mov ebp, esp
+    mov eax, 12 ; read directory system call. fill buffer with as many entries as fit
+    push dword[ebp + 16] ; "size" variable
+    push dword[ebp + 12] ; "buffer" variable
+    push dword[ebp + 8] ; "directory_descriptor" variable
+    int 0x80
+    add esp, 12
+    pop ebp
+    ret
+
+; int firstos_close_directory(int directory_descriptor)
+firstos_close_directory:
+    push ebp
+    mov ebp, esp
+    mov eax, 13 ; close directory system call
+    push dword[ebp + 8] ; "directory_descriptor" variable
+    int 0x80
+    add esp, 4
+    pop ebp
+    ret
+
+; int firstos_open(const char* path, const char* mode)
+firstos_open:
+    push ebp
+    mov ebp, esp
+    mov eax, 14 ; open file system call
+    push dword[ebp + 12] ; "mode" variable
+    push dword[ebp + 8] ; "path" variable
+    int 0x80
+    add esp, 8
+    pop ebp
+    ret
+
+; int firstos_read(int file_descriptor, void* buffer, size_t size)
+firstos_read:
+    push ebp
+    mov ebp, esp
+    mov eax, 15 ; read file system call. data is copied straight into buffer
+    push dword[ebp + 16] ; "size" variable
+    push dword[ebp + 12] ; "buffer" variable
+    push dword[ebp + 8] ; "file_descriptor" variable
+    int 0x80
+    add esp, 12
+    pop ebp
+    ret
+
+; int firstos_seek(int file_descriptor, int offset, int whence)
+firstos_seek:
+    push ebp
+    mov ebp, esp
+    mov eax, 16 ; seek file system call
+    push dword[ebp + 16] ; "whence" variable
+    push dword[ebp + 12] ; "offset" variable
+    push dword[ebp + 8] ; "file_descriptor" variable
+    int 0x80
+    add esp, 12
+    pop ebp
+    ret
+
+; int firstos_stat(int file_descriptor, struct file_stat* stat)
+firstos_stat:
+    push ebp
+    mov ebp, esp
+    mov eax, 17 ; stat file system call
+    push dword[ebp + 12] ; "stat" variable
+    push dword[ebp + 8] ; "file_descriptor" variable
+    int 0x80
+    add esp, 8
+    pop ebp
+    ret
+
+; int firstos_close(int file_descriptor)
+firstos_close:
+    push ebp
+    mov ebp, esp
+    mov eax, 18 ; close file system call
+    push dword[ebp + 8] ; "file_descriptor" variable
+    int 0x80
+    add esp, 4
+    pop ebp
+    ret
+
+; int firstos_mount(int drive_num, int disk_id)
+firstos_mount:
+    push ebp
+    mov ebp, esp
+    mov eax, 19 ; mount system call
+    push dword[ebp + 12] ; "disk_id" variable
+    push dword[ebp + 8] ; "drive_num" variable
+    int 0x80
+    add esp, 8
+    pop ebp
+    ret
+
+; int firstos_unmount(int drive_num)
+firstos_unmount:
+    push ebp
+    mov ebp, esp
+    mov eax, 20 ; unmount system call
+    push dword[ebp + 8] ; "drive_num" variable
+    int 0x80
+    add esp, 4
+    pop ebp
+    ret
+
+; int firstos_write(int file_descriptor, const void* buffer, size_t size)
+firstos_write:
+    push ebp
+    mov ebp, esp
+    mov eax, 21 ; write file system call. data is taken straight from buffer
+    push dword[ebp + 16] ; "size" variable
+    push dword[ebp + 12] ; "buffer" variable
+    push dword[ebp + 8] ; "file_descriptor" variable
+    int 0x80
+    add esp, 12
+    pop ebp
     ret
\ No newline at end of file
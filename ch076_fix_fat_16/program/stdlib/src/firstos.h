@@ -3,6 +3,14 @@
 
 #include <stddef.h>
 #include <stdbool.h>
+#include <stdint.h>
+
+#define FIRSTOS_DIRECTORY_ENTRY_READ_ONLY 0b00000001
+#define FIRSTOS_DIRECTORY_ENTRY_DIRECTORY 0b00000010
+
+#define FIRSTOS_SEEK_SET 0
+#define FIRSTOS_SEEK_CURRENT 1
+#define FIRSTOS_SEEK_END 2
 
 struct command_argument {
     char argument[512];
@@ -14,6 +22,20 @@ struct process_arguments {
     char** argv;
 };
 
+// filled by firstos_read_directory. Entries are packed one after another, record_length bytes from one entry to the next
+struct directory_entry {
+    uint16_t record_length;
+    uint16_t flags;
+    uint32_t file_size;
+    char name[]; // null terminated
+};
+
+// filled by firstos_stat, flags are FIRSTOS_DIRECTORY_ENTRY_* flags
+struct file_stat {
+    uint32_t flags;
+    uint32_t file_size;
+};
+
 struct command_argument* firstos_parse_command(const char* command, int max);
 
 void print(const char* message);
@@ -31,5 +53,27 @@ int firstos_command(struct command_argument* arguments);
 int firstos_command_run(const char* command);
 
 void fistos_exit();
+int firstos_sync();
+
+int firstos_open_directory(const char* path);
+int firstos_read_directory(int directory_descriptor, void* buffer, size_t size);
+int firstos_close_directory(int directory_descriptor);
+
+// path is relative to drive 0 unless it names a drive (e.g., 9:/tmp.txt for scratch ramfs),
+// mode is "r", "w" or "a". Return file descriptor, 0 on failure
+int firstos_open(const char* path, const char* mode);
+// other file functions return negative on failure
+// return bytes read, less than size at end of file
+int firstos_read(int file_descriptor, void* buffer, size_t size);
+// return bytes written
+int firstos_write(int file_descriptor, const void* buffer, size_t size);
+int firstos_seek(int file_descriptor, int offset, int whence);
+int firstos_stat(int file_descriptor, struct file_stat* stat);
+int firstos_close(int file_descriptor);
+
+// filesystem of disk becomes reachable through "${drive_num}:/" paths. Return negative on failure
+int firstos_mount(int drive_num, int disk_id);
+// fails while any file or directory on the drive is open
+int firstos_unmount(int drive_num);
 
 #endif
\ No newline at end of file
@@ -4,6 +4,14 @@ BITS 16 ; 16 bit mode
 CODE_SEG equ gdt_code - gdt_start
 DATA_SEG equ gdt_data - gdt_start
 
+; disk layout: boot sector, kernel in fixed KERNEL_SECTORS, then initramfs. All of them sit in reserved sectors before FAT
+KERNEL_SECTORS equ 400
+INITRAMFS_LBA equ 1 + KERNEL_SECTORS
+; same as fs/ramfs/initramfs.h
+INITRAMFS_ADDRESS equ 0x00800000
+INITRAMFS_SIGNATURE equ 0x53465249
+INITRAMFS_MAX_SECTORS equ 4096 - INITRAMFS_LBA
+
 ; first 3 bytes are meaningful. They will indicate where to start execute
 _bios_parameter:
     jmp short _set_code_segment
@@ -14,7 +22,7 @@ _bios_parameter:
 OEMIdentifier db 'FIRSTOS '; OEM name. Need to be 8 bytes
 BytesPerSector dw 0x200 ; 512 byes per sector -> cannot change disk behavior
 SectorsPerCluster db 0x80
-ReservedSectors dw 200 ; decimal 200. Means keep 200 sectors for placing kernel
+ReservedSectors dw 4096 ; decimal 4096. Means keep 4096 sectors for placing kernel and initramfs
 FATCopies db 0x02 ; 2 FAT copies
 RootDirEntries dw 0x40
 NumSectors dw 0x00
@@ -101,12 +109,58 @@ gdt_descriptor:
 
 [BITS 32]
 load32:
+    ; data segments with 4GB limit, initramfs header is checked through ds
+    mov ax, DATA_SEG
+    mov ds, ax
+    mov es, ax
+
     mov eax, 1 ; starting sector we'd like to load from
-    mov ecx, 100 ; 100 sectors, total number of sectors we'd like to load
+    mov ecx, KERNEL_SECTORS ; total number of sectors we'd like to load
     mov edi, 0x0100000 ; 1M, the memory address we'd like to load kernel into
-    call ata_lba_read ; load kernel
+    call ata_lba_read_large ; load kernel
+
+    ; initramfs follows kernel on disk. Its first sector tells how many bytes it takes
+    mov eax, INITRAMFS_LBA
+    mov ecx, 1
+    mov edi, INITRAMFS_ADDRESS
+    call ata_lba_read
+    cmp dword[INITRAMFS_ADDRESS], INITRAMFS_SIGNATURE
+    jne .start_kernel ; no initramfs, kernel reads everything from disk
+
+    mov ecx, dword[INITRAMFS_ADDRESS + 4] ; total size in bytes
+    add ecx, 511
+    shr ecx, 9 ; bytes to sectors
+    cmp ecx, INITRAMFS_MAX_SECTORS
+    ja .start_kernel ; broken image, kernel rejects it as well
+    dec ecx ; first sector is loaded already
+    mov eax, INITRAMFS_LBA + 1
+    call ata_lba_read_large
+
+.start_kernel:
     jmp CODE_SEG:0x0100000 ; jump to kernel code
 
+; sector count register is 8 bit, so read at most 128 sectors a time. edi keeps moving forward
+ata_lba_read_large:
+    mov esi, ecx ; sectors left
+.next_chunk:
+    test esi, esi
+    jz .done
+    mov ecx, esi
+    cmp ecx, 128
+    jbe .read_chunk
+    mov ecx, 128
+.read_chunk:
+    sub esi, ecx
+    push eax
+    push ecx
+    call ata_lba_read
+    pop ecx
+    pop eax
+    add eax, ecx ; next LBA
+    jmp .next_chunk
+.done:
+    ret
+
 ; simple disk driver to get kernel loaded
 ata_lba_read:
     mov ebx, eax ; backup LBA to ebs
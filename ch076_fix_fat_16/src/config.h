@@ -12,6 +12,11 @@
 #define HEAP_TABLE_ADDRESS 0x00007E00 // check https://wiki.osdev.org/Memory_Map_(x86) . Available size here is 480.5 KB, which is enough for placing 25600 byte table
 
 #define DISK_SECTOR_SIZE 512
+#define MAX_DISKS 10 // path only accepts single digit drive number(0-9)
+#define MAX_MOUNTS 10 // one per drive number
+#define INITRAMFS_DRIVE_NUM 0 // core programs loaded with kernel, reserved even if there is no boot image
+#define FIRST_PHYSICAL_DRIVE_NUM 1 // physical disks take following drive numbers in detection order, skipping SCRATCH_DRIVE_NUM
+#define SCRATCH_DRIVE_NUM 9 // ramfs for temporary files, e.g. 9:/tmp.txt
 
 #define MAX_FILESYSTEMS 12
 #define MAX_FILE_DESCRIPTORS 512
@@ -0,0 +1,537 @@
+#include "ahci.h"
+#include "disk.h"
+#include "pci/pci.h"
+#include "memory/memory.h"
+#include "memory/heap/kheap.h"
+#include "config.h"
+#include "status.h"
+
+// prevent infinity loop when device never responds
+#define AHCI_SPIN_TIMEOUT 1000000
+
+static int initialize_ahci_controller(struct pci_device* pci_device, struct ahci_device** devices, int max_devices);
+static bool is_sata_drive_attached(volatile struct hba_port* port);
+static int initialize_ahci_device(volatile struct hba_memory* hba, int port_number, struct ahci_device* device);
+static void stop_command_engine(volatile struct hba_port* port);
+static void start_command_engine(volatile struct hba_port* port);
+static int identify_ahci_device(struct ahci_device* device);
+static int wait_until_port_idle(volatile struct hba_port* port);
+static int find_free_command_slot(struct ahci_device* device, uint32_t slots_in_use);
+static struct hba_command_table* prepare_command(struct ahci_device* device, int slot, void* buffer, int total_bytes, bool write);
+static void fill_lba(struct fis_register_h2d* fis, unsigned int lba);
+static int issue_transfer_command(struct ahci_device* device, int slot, unsigned int lba, int total_num_blocks, void* buffer, bool write);
+static int transfer_requests(struct ahci_device* device, struct disk_request* requests, int total_requests, bool write);
+static int wait_for_commands(struct ahci_device* device, uint32_t slots);
+static void recover_port(struct ahci_device* device);
+static bool are_requests_dma_aligned(struct disk_request* requests, int total_requests);
+static int queue_requests(struct ahci_device* device, struct disk_request* requests, int total_requests, bool write);
+static int transfer_request_with_bounce_buffer(struct ahci_device* device, struct disk_request* request, bool write);
+
+int search_and_initialize_ahci_devices(struct ahci_device** devices, int max_devices) {
+    int total_devices = 0;
+    struct pci_device pci_device;
+
+    // there might be more than one AHCI controller
+    for (int i = 0; find_pci_device_by_class(AHCI_PCI_CLASS, AHCI_PCI_SUBCLASS, AHCI_PCI_PROG_IF, i, &pci_device) == ALL_OK; i++) {
+        if (total_devices >= max_devices) {
+            break;
+        }
+
+        int result = initialize_ahci_controller(&pci_device, devices + total_devices, max_devices - total_devices);
+        if (result > 0) {
+            total_devices += result;
+        }
+    }
+
+    return total_devices;
+}
+
+static int initialize_ahci_controller(struct pci_device* pci_device, struct ahci_device** devices, int max_devices) {
+    int total_devices = 0;
+
+    // allow controller to DMA, otherwise nothing will be written to our buffers
+    enable_pci_bus_mastering(pci_device);
+
+    // the whole 4GB is identity mapped, so physical ABAR can be directly accessed
+    volatile struct hba_memory* hba = (volatile struct hba_memory*) get_pci_bar(pci_device, AHCI_PCI_BAR_INDEX);
+    if (!hba) {
+        return 0;
+    }
+
+    hba->global_host_control |= HBA_GHC_AHCI_ENABLE;
+
+    uint32_t ports_implemented = hba->ports_implemented;
+    for (int i = 0; i < AHCI_MAX_PORTS && total_devices < max_devices; i++) {
+        if (!(ports_implemented & (1 << i))) {
+            continue;
+        }
+
+        if (!is_sata_drive_attached(&hba->ports[i])) {
+            continue;
+        }
+
+        struct ahci_device* device = kzalloc(sizeof(struct ahci_device));
+        if (!device) {
+            break;
+        }
+
+        if (initialize_ahci_device(hba, i, device) != ALL_OK) {
+            kfree(device);
+            continue;
+        }
+
+        devices[total_devices] = device;
+        total_devices++;
+    }
+
+    return total_devices;
+}
+
+static bool is_sata_drive_attached(volatile struct hba_port* port) {
+    uint32_t sata_status = port->sata_status;
+    uint8_t device_detection = sata_status & 0x0F;
+    uint8_t power_management = (sata_status >> 8) & 0x0F;
+
+    if (device_detection != HBA_PORT_DEVICE_PRESENT || power_management != HBA_PORT_IPM_ACTIVE) {
+        return false;
+    }
+
+    return port->signature == SATA_SIGNATURE_ATA;
+}
+
+static int initialize_ahci_device(volatile struct hba_memory* hba, int port_number, struct ahci_device* device) {
+    int result = 0;
+    volatile struct hba_port* port = &hba->ports[port_number];
+
+    device->hba = hba;
+    device->port = port;
+    device->port_number = port_number;
+    device->total_command_slots = ((hba->host_capability >> 8) & 0x1F) + 1;
+
+    // Port should stop before changing command list and FIS base
+    stop_command_engine(port);
+
+    // Heap blocks are 4K aligned, so alignment requirements(1K for command list, 256 bytes for FIS) are satisfied.
+    // 1K command list(32 headers) followed by 256 bytes received FIS in the same block
+    void* command_list_block = kzalloc(HEAP_BLOCK_SIZE);
+    device->command_tables = kzalloc(sizeof(struct hba_command_table) * AHCI_MAX_COMMAND_SLOTS);
+    if (!command_list_block || !device->command_tables) {
+        result = -NO_FREE_MEM_ERROR;
+        goto out;
+    }
+
+    device->command_list = command_list_block;
+    device->received_fis = command_list_block + 1024;
+
+    port->command_list_base = (uint32_t) device->command_list;
+    port->command_list_base_upper = 0;
+    port->fis_base = (uint32_t) device->received_fis;
+    port->fis_base_upper = 0;
+
+    for (int i = 0; i < AHCI_MAX_COMMAND_SLOTS; i++) {
+        device->command_list[i].command_table_base = (uint32_t) &device->command_tables[i];
+        device->command_list[i].command_table_base_upper = 0;
+    }
+
+    // clear errors and pending interrupts. Bits are cleared by writing 1
+    port->sata_error = 0xFFFFFFFF;
+    port->interrupt_status = 0xFFFFFFFF;
+
+    start_command_engine(port);
+
+    result = identify_ahci_device(device);
+
+out:
+    if (result < 0) {
+        stop_command_engine(port);
+        if (command_list_block) {
+            kfree(command_list_block);
+        }
+        if (device->command_tables) {
+            kfree(device->command_tables);
+        }
+    }
+    return result;
+}
+
+static void stop_command_engine(volatile struct hba_port* port) {
+    port->command_and_status &= ~HBA_PORT_CMD_START;
+    port->command_and_status &= ~HBA_PORT_CMD_FIS_RECEIVE_ENABLE;
+
+    // wait until both command list and FIS receive engine stopped
+    for (int i = 0; i < AHCI_SPIN_TIMEOUT; i++) {
+        if (!(port->command_and_status & (HBA_PORT_CMD_FIS_RECEIVE_RUNNING | HBA_PORT_CMD_LIST_RUNNING))) {
+            break;
+        }
+    }
+}
+
+static void start_command_engine(volatile struct hba_port* port) {
+    for (int i = 0; i < AHCI_SPIN_TIMEOUT; i++) {
+        if (!(port->command_and_status & HBA_PORT_CMD_LIST_RUNNING)) {
+            break;
+        }
+    }
+
+    port->command_and_status |= HBA_PORT_CMD_FIS_RECEIVE_ENABLE;
+    port->command_and_status |= HBA_PORT_CMD_START;
+}
+
+static int identify_ahci_device(struct ahci_device* device) {
+    int result = 0;
+    uint16_t* identify_data = kzalloc(DISK_SECTOR_SIZE);
+    if (!identify_data) {
+        return -NO_FREE_MEM_ERROR;
+    }
+
+    result = wait_until_port_idle(device->port);
+    if (result < 0) {
+        goto out;
+    }
+
+    struct hba_command_table* command_table = prepare_command(device, 0, identify_data, DISK_SECTOR_SIZE, false);
+    struct fis_register_h2d* fis = (struct fis_register_h2d*) command_table->command_fis;
+    fis->command = ATA_COMMAND_IDENTIFY;
+    fis->device = 0;
+
+    device->port->command_issue = 1;
+    result = wait_for_commands(device, 1);
+    if (result < 0) {
+        goto out;
+    }
+
+    // https://wiki.osdev.org/ATA_PIO_Mode#Interesting_information_returned_by_IDENTIFY
+    // word 100-103 total LBA48 sectors, only lower 32 bits are used
+    device->total_sectors = identify_data[100] | ((uint32_t) identify_data[101] << 16);
+
+    // word 76 bit 8 -> NCQ supported. word 75 bit 0-4 -> queue depth - 1
+    device->ncq_supported = (device->hba->host_capability & HBA_CAP_NATIVE_COMMAND_QUEUING) && (identify_data[76] & (1 << 8));
+    device->queue_depth = 1;
+    if (device->ncq_supported) {
+        device->queue_depth = (identify_data[75] & 0x1F) + 1;
+        if (device->queue_depth > device->total_command_slots) {
+            device->queue_depth = device->total_command_slots;
+        }
+    }
+
+out:
+    kfree(identify_data);
+    return result;
+}
+
+static int wait_until_port_idle(volatile struct hba_port* port) {
+    for (int i = 0; i < AHCI_SPIN_TIMEOUT; i++) {
+        if (!(port->task_file_data & (ATA_STATUS_BUSY | ATA_STATUS_DRQ))) {
+            return ALL_OK;
+        }
+    }
+
+    return -IO_ERROR;
+}
+
+// slot is free when HBA neither processing it(command issue) nor device holding it(SATA active)
+static int find_free_command_slot(struct ahci_device* device, uint32_t slots_in_use) {
+    uint32_t busy_slots = device->port->sata_active | device->port->command_issue | slots_in_use;
+    for (int i = 0; i < device->total_command_slots; i++) {
+        if (!(busy_slots & (1 << i))) {
+            return i;
+        }
+    }
+
+    return -IS_TAKEN_ERROR;
+}
+
+// Setup command header and PRDT entries of the slot.
+// Buffer is split into several PRDT entries, each one describes at most AHCI_PRDT_ENTRY_MAX_BYTES.
+// Buffer must be word aligned and total_bytes is a multiple of sector size,
+// so every entry has even byte count(odd in byte_count field since it's stored as count - 1)
+static struct hba_command_table* prepare_command(struct ahci_device* device, int slot, void* buffer, int total_bytes, bool write) {
+    struct hba_command_header* header = &device->command_list[slot];
+    struct hba_command_table* command_table = &device->command_tables[slot];
+    int total_prdt_entries = (total_bytes + AHCI_PRDT_ENTRY_MAX_BYTES - 1) / AHCI_PRDT_ENTRY_MAX_BYTES;
+
+    header->command_fis_length = sizeof(struct fis_register_h2d) / sizeof(uint32_t);
+    header->write = write ? 1 : 0;
+    header->prdt_length = total_prdt_entries;
+    header->prd_byte_count = 0;
+
+    memset(command_table, 0, sizeof(struct hba_command_table));
+
+    uint8_t* current_buffer = buffer;
+    int rest_bytes = total_bytes;
+    for (int i = 0; i < total_prdt_entries; i++) {
+        int current_bytes = rest_bytes > AHCI_PRDT_ENTRY_MAX_BYTES ? AHCI_PRDT_ENTRY_MAX_BYTES : rest_bytes;
+        command_table->prdt_entries[i].data_base = (uint32_t) current_buffer;
+        command_table->prdt_entries[i].data_base_upper = 0;
+        command_table->prdt_entries[i].byte_count = current_bytes - 1;
+        command_table->prdt_entries[i].interrupt_on_completion = 0;
+        current_buffer += current_bytes;
+        rest_bytes -= current_bytes;
+    }
+
+    struct fis_register_h2d* fis = (struct fis_register_h2d*) command_table->command_fis;
+    fis->fis_type = FIS_TYPE_REGISTER_H2D;
+    fis->is_command = 1;
+
+    return command_table;
+}
+
+static void fill_lba(struct fis_register_h2d* fis, unsigned int lba) {
+    fis->lba0 = (uint8_t) lba;
+    fis->lba1 = (uint8_t) (lba >> 8);
+    fis->lba2 = (uint8_t) (lba >> 16);
+    fis->lba3 = (uint8_t) (lba >> 24);
+    fis->lba4 = 0;
+    fis->lba5 = 0;
+}
+
+static int issue_transfer_command(struct ahci_device* device, int slot, unsigned int lba, int total_num_blocks, void* buffer, bool write) {
+    struct hba_command_table* command_table = prepare_command(device, slot, buffer, total_num_blocks * DISK_SECTOR_SIZE, write);
+    struct fis_register_h2d* fis = (struct fis_register_h2d*) command_table->command_fis;
+    fill_lba(fis, lba);
+    fis->device = 1 << 6; // LBA mode
+
+    if (device->ncq_supported) {
+        // For queued command, sector count is placed in feature register, and tag(slot) in count register
+        fis->command = write ? ATA_COMMAND_WRITE_FPDMA_QUEUED : ATA_COMMAND_READ_FPDMA_QUEUED;
+        fis->feature_low = total_num_blocks & 0xFF;
+        fis->feature_high = (total_num_blocks >> 8) & 0xFF;
+        fis->count_low = slot << 3;
+
+        // SATA active must be set before command issue
+        device->port->sata_active = 1 << slot;
+    } else {
+        fis->command = write ? ATA_COMMAND_WRITE_DMA_EXT : ATA_COMMAND_READ_DMA_EXT;
+        fis->count_low = total_num_blocks & 0xFF;
+        fis->count_high = (total_num_blocks >> 8) & 0xFF;
+    }
+
+    device->port->command_issue = 1 << slot;
+
+    return ALL_OK;
+}
+
+// poll until all given slots are completed, or any error occurs
+static int wait_for_commands(struct ahci_device* device, uint32_t slots) {
+    for (int i = 0; i < AHCI_SPIN_TIMEOUT; i++) {
+        if (device->port->interrupt_status & HBA_PORT_IS_TASK_FILE_ERROR) {
+            recover_port(device);
+            return -IO_ERROR;
+        }
+
+        if (!((device->port->command_issue | device->port->sata_active) & slots)) {
+            return ALL_OK;
+        }
+    }
+
+    // device stuck, outstanding slots would block every later command
+    recover_port(device);
+    return -IO_ERROR;
+}
+
+// Port stops processing commands after task file error, until software restarts it.
+// AHCI 1.3.1 section 6.2.2.1
+static void recover_port(struct ahci_device* device) {
+    volatile struct hba_port* port = device->port;
+
+    // clearing start makes HBA clear command issue and SATA active, so every outstanding slot is dropped
+    port->command_and_status &= ~HBA_PORT_CMD_START;
+    for (int i = 0; i < AHCI_SPIN_TIMEOUT; i++) {
+        if (!(port->command_and_status & HBA_PORT_CMD_LIST_RUNNING)) {
+            break;
+        }
+    }
+
+    // bits are cleared by writing 1
+    port->sata_error = 0xFFFFFFFF;
+    port->interrupt_status = 0xFFFFFFFF;
+
+    // device still holds busy or DRQ, only COMRESET brings it back
+    if (port->task_file_data & (ATA_STATUS_BUSY | ATA_STATUS_DRQ)) {
+        port->sata_control = (port->sata_control & ~HBA_PORT_SCTL_DET_MASK) | HBA_PORT_SCTL_DET_INIT;
+        // DET must be kept at least 1ms
+        for (volatile int i = 0; i < AHCI_SPIN_TIMEOUT; i++) {
+        }
+        port->sata_control &= ~HBA_PORT_SCTL_DET_MASK;
+        wait_until_port_idle(port);
+        port->sata_error = 0xFFFFFFFF;
+    }
+
+    port->command_and_status |= HBA_PORT_CMD_START;
+}
+
+int ahci_read_sectors(struct ahci_device* device, unsigned int lba, int total_num_blocks, void* buffer) {
+    struct disk_request request = {
+        .lba = lba,
+        .total_num_blocks = total_num_blocks,
+        .buffer = buffer,
+    };
+
+    return ahci_read_requests(device, &request, 1);
+}
+
+int ahci_write_sectors(struct ahci_device* device, unsigned int lba, int total_num_blocks, void* buffer) {
+    struct disk_request request = {
+        .lba = lba,
+        .total_num_blocks = total_num_blocks,
+        .buffer = buffer,
+    };
+
+    return ahci_write_requests(device, &request, 1);
+}
+
+int ahci_read_requests(struct ahci_device* device, struct disk_request* requests, int total_requests) {
+    return transfer_requests(device, requests, total_requests, false);
+}
+
+int ahci_write_requests(struct ahci_device* device, struct disk_request* requests, int total_requests) {
+    return transfer_requests(device, requests, total_requests, true);
+}
+
+// Buffers are used for DMA directly when all of them are word aligned.
+// Otherwise fall back to one request at a time, and copy unaligned ones through a bounce buffer
+static int transfer_requests(struct ahci_device* device, struct disk_request* requests, int total_requests, bool write) {
+    int result = 0;
+
+    if (are_requests_dma_aligned(requests, total_requests)) {
+        return queue_requests(device, requests, total_requests, write);
+    }
+
+    for (int i = 0; i < total_requests; i++) {
+        if (are_requests_dma_aligned(&requests[i], 1)) {
+            result = queue_requests(device, &requests[i], 1, write);
+        } else {
+            result = transfer_request_with_bounce_buffer(device, &requests[i], write);
+        }
+
+        if (result < 0) {
+            break;
+        }
+    }
+
+    return result;
+}
+
+static bool are_requests_dma_aligned(struct disk_request* requests, int total_requests) {
+    for (int i = 0; i < total_requests; i++) {
+        if ((uint32_t) requests[i].buffer % AHCI_DMA_ALIGNMENT) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// heap blocks are page aligned, so the bounce buffer is always usable for DMA
+static int transfer_request_with_bounce_buffer(struct ahci_device* device, struct disk_request* request, bool write) {
+    int result = 0;
+    int max_blocks_per_command = AHCI_MAX_BYTES_PER_COMMAND / DISK_SECTOR_SIZE;
+    int rest_blocks = request->total_num_blocks;
+    unsigned int lba = request->lba;
+    uint8_t* current_buffer = request->buffer;
+
+    if (rest_blocks <= 0) {
+        return ALL_OK;
+    }
+
+    int bounce_blocks = rest_blocks > max_blocks_per_command ? max_blocks_per_command : rest_blocks;
+    uint8_t* bounce_buffer = kzalloc(bounce_blocks * DISK_SECTOR_SIZE);
+    if (!bounce_buffer) {
+        return -NO_FREE_MEM_ERROR;
+    }
+
+    while (rest_blocks > 0) {
+        int current_num_blocks = rest_blocks > bounce_blocks ? bounce_blocks : rest_blocks;
+        int current_bytes = current_num_blocks * DISK_SECTOR_SIZE;
+        struct disk_request bounce_request = {
+            .lba = lba,
+            .total_num_blocks = current_num_blocks,
+            .buffer = bounce_buffer,
+        };
+
+        if (write) {
+            memcpy(bounce_buffer, current_buffer, current_bytes);
+        }
+
+        result = queue_requests(device, &bounce_request, 1, write);
+        if (result < 0) {
+            goto out;
+        }
+
+        if (!write) {
+            memcpy(current_buffer, bounce_buffer, current_bytes);
+        }
+
+        lba += current_num_blocks;
+        current_buffer += current_bytes;
+        rest_blocks -= current_num_blocks;
+    }
+
+out:
+    kfree(bounce_buffer);
+    return result;
+}
+
+// Every request is split into commands of at most AHCI_MAX_BYTES_PER_COMMAND.
+// With NCQ, up to queue_depth commands(possibly from different requests) are issued before waiting,
+// so device can serve them out of order.
+static int queue_requests(struct ahci_device* device, struct disk_request* requests, int total_requests, bool write) {
+    int result = 0;
+    int max_blocks_per_command = AHCI_MAX_BYTES_PER_COMMAND / DISK_SECTOR_SIZE;
+    int current_request = 0;
+
+    if (total_requests <= 0) {
+        goto out;
+    }
+
+    unsigned int lba = requests[0].lba;
+    int total_num_blocks = requests[0].total_num_blocks;
+    uint8_t* current_buffer = requests[0].buffer;
+
+    result = wait_until_port_idle(device->port);
+    if (result < 0) {
+        goto out;
+    }
+
+    while (current_request < total_requests) {
+        uint32_t issued_slots = 0;
+
+        for (int i = 0; i < device->queue_depth && current_request < total_requests; i++) {
+            int slot = find_free_command_slot(device, issued_slots);
+            if (slot < 0) {
+                break;
+            }
+
+            int current_num_blocks = total_num_blocks > max_blocks_per_command ? max_blocks_per_command : total_num_blocks;
+            issue_transfer_command(device, slot, lba, current_num_blocks, current_buffer, write);
+            issued_slots |= 1 << slot;
+
+            lba += current_num_blocks;
+            current_buffer += current_num_blocks * DISK_SECTOR_SIZE;
+            total_num_blocks -= current_num_blocks;
+
+            // move to next request once current one fully issued
+            if (total_num_blocks <= 0) {
+                current_request++;
+                if (current_request < total_requests) {
+                    lba = requests[current_request].lba;
+                    total_num_blocks = requests[current_request].total_num_blocks;
+                    current_buffer = requests[current_request].buffer;
+                }
+            }
+        }
+
+        if (!issued_slots) {
+            result = -IS_TAKEN_ERROR;
+            goto out;
+        }
+
+        result = wait_for_commands(device, issued_slots);
+        if (result < 0) {
+            goto out;
+        }
+    }
+
+out:
+    return result;
+}
@@ -0,0 +1,200 @@
+#ifndef AHCI_H
+#define AHCI_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// https://wiki.osdev.org/AHCI
+// Serial ATA AHCI 1.3.1 Specification
+
+// PCI class of AHCI controller: mass storage(0x01), SATA(0x06), AHCI 1.0(0x01)
+#define AHCI_PCI_CLASS 0x01
+#define AHCI_PCI_SUBCLASS 0x06
+#define AHCI_PCI_PROG_IF 0x01
+// ABAR(AHCI base memory register) is BAR5
+#define AHCI_PCI_BAR_INDEX 5
+
+#define AHCI_MAX_PORTS 32
+#define AHCI_MAX_COMMAND_SLOTS 32
+
+// every PRDT entry describes at most 4MB, but keep it small so a single request is split into several entries(scatter-gather)
+#define AHCI_PRDT_ENTRY_MAX_BYTES 0x10000
+#define AHCI_PRDT_ENTRIES_PER_COMMAND 8
+#define AHCI_MAX_BYTES_PER_COMMAND (AHCI_PRDT_ENTRY_MAX_BYTES * AHCI_PRDT_ENTRIES_PER_COMMAND)
+// data base address of PRDT entry must be word aligned, other buffers go through a bounce buffer
+#define AHCI_DMA_ALIGNMENT 2
+
+// Frame information structure types
+#define FIS_TYPE_REGISTER_H2D 0x27
+
+// ATA commands
+#define ATA_COMMAND_READ_DMA_EXT 0x25
+#define ATA_COMMAND_READ_FPDMA_QUEUED 0x60
+#define ATA_COMMAND_WRITE_DMA_EXT 0x35
+#define ATA_COMMAND_WRITE_FPDMA_QUEUED 0x61
+#define ATA_COMMAND_IDENTIFY 0xEC
+
+// SATA signature for plain SATA drive(not ATAPI/port multiplier)
+#define SATA_SIGNATURE_ATA 0x00000101
+
+// Host capability
+#define HBA_CAP_NATIVE_COMMAND_QUEUING (1 << 30)
+// Global host control
+#define HBA_GHC_AHCI_ENABLE (1 << 31)
+
+// Port command and status
+#define HBA_PORT_CMD_START 0x0001
+#define HBA_PORT_CMD_FIS_RECEIVE_ENABLE 0x0010
+#define HBA_PORT_CMD_FIS_RECEIVE_RUNNING 0x4000
+#define HBA_PORT_CMD_LIST_RUNNING 0x8000
+
+// Port interrupt status, task file error
+#define HBA_PORT_IS_TASK_FILE_ERROR (1 << 30)
+
+// Port SATA control, device detection initialization(COMRESET)
+#define HBA_PORT_SCTL_DET_MASK 0x0F
+#define HBA_PORT_SCTL_DET_INIT 0x01
+
+// Port SATA status
+#define HBA_PORT_DEVICE_PRESENT 0x03
+#define HBA_PORT_IPM_ACTIVE 0x01
+
+// Task file data
+#define ATA_STATUS_BUSY 0x80
+#define ATA_STATUS_DRQ 0x08
+
+struct hba_port {
+    uint32_t command_list_base;
+    uint32_t command_list_base_upper;
+    uint32_t fis_base;
+    uint32_t fis_base_upper;
+    uint32_t interrupt_status;
+    uint32_t interrupt_enable;
+    uint32_t command_and_status;
+    uint32_t reserved0;
+    uint32_t task_file_data;
+    uint32_t signature;
+    uint32_t sata_status;
+    uint32_t sata_control;
+    uint32_t sata_error;
+    uint32_t sata_active; // bit set for outstanding NCQ command of a slot
+    uint32_t command_issue; // bit set for issued command of a slot
+    uint32_t sata_notification;
+    uint32_t fis_based_switch_control;
+    uint32_t reserved1[11];
+    uint32_t vendor[4];
+} __attribute__((packed));
+
+// memory mapped registers pointed by ABAR
+struct hba_memory {
+    uint32_t host_capability;
+    uint32_t global_host_control;
+    uint32_t interrupt_status;
+    uint32_t ports_implemented;
+    uint32_t version;
+    uint32_t ccc_control;
+    uint32_t ccc_ports;
+    uint32_t enclosure_management_location;
+    uint32_t enclosure_management_control;
+    uint32_t host_capability_extended;
+    uint32_t bios_handoff;
+    uint8_t reserved[0x74];
+    uint8_t vendor[0x60];
+    struct hba_port ports[AHCI_MAX_PORTS];
+} __attribute__((packed));
+
+// Host to device register FIS. Used to send ATA command to device
+struct fis_register_h2d {
+    uint8_t fis_type;
+    uint8_t port_multiplier:4;
+    uint8_t reserved0:3;
+    uint8_t is_command:1; // 1 for command, 0 for control
+    uint8_t command;
+    uint8_t feature_low;
+
+    uint8_t lba0;
+    uint8_t lba1;
+    uint8_t lba2;
+    uint8_t device;
+
+    uint8_t lba3;
+    uint8_t lba4;
+    uint8_t lba5;
+    uint8_t feature_high;
+
+    uint8_t count_low;
+    uint8_t count_high;
+    uint8_t isochronous_command_completion;
+    uint8_t control;
+
+    uint8_t reserved1[4];
+} __attribute__((packed));
+
+// entry of command list, one per command slot
+struct hba_command_header {
+    uint8_t command_fis_length:5; // in double words
+    uint8_t atapi:1;
+    uint8_t write:1; // 1 for host to device
+    uint8_t prefetchable:1;
+
+    uint8_t reset:1;
+    uint8_t bist:1;
+    uint8_t clear_busy_upon_ok:1;
+    uint8_t reserved0:1;
+    uint8_t port_multiplier:4;
+
+    uint16_t prdt_length; // num of PRDT entries
+
+    volatile uint32_t prd_byte_count; // bytes transferred, updated by HBA
+
+    uint32_t command_table_base; // 128 bytes aligned
+    uint32_t command_table_base_upper;
+
+    uint32_t reserved1[4];
+} __attribute__((packed));
+
+// physical region descriptor table entry. Describe one memory region for DMA
+struct hba_prdt_entry {
+    uint32_t data_base;
+    uint32_t data_base_upper;
+    uint32_t reserved0;
+
+    uint32_t byte_count:22; // 0 based, means actual byte count - 1
+    uint32_t reserved1:9;
+    uint32_t interrupt_on_completion:1;
+} __attribute__((packed));
+
+struct hba_command_table {
+    uint8_t command_fis[64];
+    uint8_t atapi_command[16];
+    uint8_t reserved[48];
+    struct hba_prdt_entry prdt_entries[AHCI_PRDT_ENTRIES_PER_COMMAND];
+} __attribute__((packed));
+
+// a SATA drive attached to an AHCI port
+struct ahci_device {
+    volatile struct hba_memory* hba;
+    volatile struct hba_port* port;
+    int port_number;
+
+    struct hba_command_header* command_list;
+    void* received_fis;
+    struct hba_command_table* command_tables;
+
+    int total_command_slots;
+    // native command queuing. Allow multiple read commands outstanding at the same time
+    bool ncq_supported;
+    int queue_depth;
+
+    uint32_t total_sectors;
+};
+
+struct disk_request;
+
+int search_and_initialize_ahci_devices(struct ahci_device** devices, int max_devices);
+int ahci_read_sectors(struct ahci_device* device, unsigned int lba, int total_num_blocks, void* buffer);
+int ahci_read_requests(struct ahci_device* device, struct disk_request* requests, int total_requests);
+int ahci_write_sectors(struct ahci_device* device, unsigned int lba, int total_num_blocks, void* buffer);
+int ahci_write_requests(struct ahci_device* device, struct disk_request* requests, int total_requests);
+
+#endif
@@ -0,0 +1,244 @@
+#include "ata.h"
+#include "io/io.h"
+#include "memory/heap/kheap.h"
+#include "config.h"
+#include "status.h"
+
+// prevent infinity loop when drive never responds
+#define ATA_SPIN_TIMEOUT 1000000
+
+static int identify_ata_device(uint16_t io_base, uint8_t drive, uint16_t* identify_data);
+static int wait_until_not_busy(uint16_t io_base);
+static int wait_until_data_ready(uint16_t io_base);
+static void wait_400ns(uint16_t control_base);
+static int read_sectors_in_single_command(struct ata_device* device, unsigned int lba, int total_num_blocks, void* buffer);
+static int write_sectors_in_single_command(struct ata_device* device, unsigned int lba, int total_num_blocks, void* buffer);
+static void send_sectors_command(struct ata_device* device, unsigned int lba, int total_num_blocks, unsigned char command);
+static int flush_cache(struct ata_device* device);
+
+// Probe in order: primary master, primary slave, secondary master, secondary slave.
+// Primary master is the disk OS booted from, so it always comes first
+int search_and_initialize_ata_devices(struct ata_device** devices, int max_devices) {
+    const uint16_t io_bases[] = {ATA_PRIMARY_IO_BASE, ATA_SECONDARY_IO_BASE};
+    const uint16_t control_bases[] = {ATA_PRIMARY_CONTROL_BASE, ATA_SECONDARY_CONTROL_BASE};
+    int total_devices = 0;
+    uint16_t identify_data[256];
+
+    for (int channel = 0; channel < 2; channel++) {
+        for (uint8_t drive = ATA_MASTER; drive <= ATA_SLAVE; drive++) {
+            if (total_devices >= max_devices) {
+                goto out;
+            }
+
+            if (identify_ata_device(io_bases[channel], drive, identify_data) != ALL_OK) {
+                continue;
+            }
+
+            struct ata_device* device = kzalloc(sizeof(struct ata_device));
+            if (!device) {
+                goto out;
+            }
+
+            device->io_base = io_bases[channel];
+            device->control_base = control_bases[channel];
+            device->drive = drive;
+            // word 60-61 total LBA28 addressable sectors
+            device->total_sectors = identify_data[60] | ((uint32_t) identify_data[61] << 16);
+
+            devices[total_devices] = device;
+            total_devices++;
+        }
+    }
+
+out:
+    return total_devices;
+}
+
+static int identify_ata_device(uint16_t io_base, uint8_t drive, uint16_t* identify_data) {
+    // floating bus, no controller on the channel
+    if (insb(io_base + ATA_REGISTER_STATUS) == 0xFF) {
+        return -IO_ERROR;
+    }
+
+    outb(io_base + ATA_REGISTER_DRIVE_SELECT, 0xA0 | (drive << 4));
+    outb(io_base + ATA_REGISTER_SECTOR_COUNT, 0);
+    outb(io_base + ATA_REGISTER_LBA_LOW, 0);
+    outb(io_base + ATA_REGISTER_LBA_MID, 0);
+    outb(io_base + ATA_REGISTER_LBA_HIGH, 0);
+    outb(io_base + ATA_REGISTER_COMMAND, ATA_COMMAND_IDENTIFY);
+
+    // status 0 means no drive attached
+    if (insb(io_base + ATA_REGISTER_STATUS) == 0) {
+        return -IO_ERROR;
+    }
+
+    if (wait_until_not_busy(io_base) != ALL_OK) {
+        return -IO_ERROR;
+    }
+
+    // ATAPI/SATA drives set LBA mid/high, they are not handled by this driver
+    if (insb(io_base + ATA_REGISTER_LBA_MID) != 0 || insb(io_base + ATA_REGISTER_LBA_HIGH) != 0) {
+        return -IO_ERROR;
+    }
+
+    if (wait_until_data_ready(io_base) != ALL_OK) {
+        return -IO_ERROR;
+    }
+
+    for (int i = 0; i < 256; i++) {
+        identify_data[i] = insw(io_base + ATA_REGISTER_DATA);
+    }
+
+    return ALL_OK;
+}
+
+static int wait_until_not_busy(uint16_t io_base) {
+    for (int i = 0; i < ATA_SPIN_TIMEOUT; i++) {
+        if (!(insb(io_base + ATA_REGISTER_STATUS) & ATA_STATUS_BSY)) {
+            return ALL_OK;
+        }
+    }
+
+    return -IO_ERROR;
+}
+
+static int wait_until_data_ready(uint16_t io_base) {
+    for (int i = 0; i < ATA_SPIN_TIMEOUT; i++) {
+        unsigned char status = insb(io_base + ATA_REGISTER_STATUS);
+        if (status & (ATA_STATUS_ERR | ATA_STATUS_DF)) {
+            return -IO_ERROR;
+        }
+
+        if (!(status & ATA_STATUS_BSY) && (status & ATA_STATUS_DRQ)) {
+            return ALL_OK;
+        }
+    }
+
+    return -IO_ERROR;
+}
+
+// reading alternate status 4 times takes around 400ns, which is the time drive needs to push status after drive select
+static void wait_400ns(uint16_t control_base) {
+    for (int i = 0; i < 4; i++) {
+        insb(control_base);
+    }
+}
+
+// implement ata_lba_read in boot.asm in C lang
+// sector count register is only 8 bits, so large reads are split into several commands
+int ata_read_sectors(struct ata_device* device, unsigned int lba, int total_num_blocks, void* buffer) {
+    int result = 0;
+
+    while (total_num_blocks > 0) {
+        int current_num_blocks = total_num_blocks > ATA_MAX_SECTORS_PER_COMMAND ? ATA_MAX_SECTORS_PER_COMMAND : total_num_blocks;
+        result = read_sectors_in_single_command(device, lba, current_num_blocks, buffer);
+        if (result < 0) {
+            break;
+        }
+
+        lba += current_num_blocks;
+        buffer += current_num_blocks * DISK_SECTOR_SIZE;
+        total_num_blocks -= current_num_blocks;
+    }
+
+    return result;
+}
+
+static void send_sectors_command(struct ata_device* device, unsigned int lba, int total_num_blocks, unsigned char command) {
+    uint16_t io_base = device->io_base;
+
+    outb(io_base + ATA_REGISTER_DRIVE_SELECT, (lba >> 24) | 0xE0 | (device->drive << 4));
+    wait_400ns(device->control_base);
+    outb(io_base + ATA_REGISTER_SECTOR_COUNT, (unsigned char) total_num_blocks); // 0 stands for 256 sectors
+    outb(io_base + ATA_REGISTER_LBA_LOW, (unsigned char)(lba & 0xff));
+    outb(io_base + ATA_REGISTER_LBA_MID, (unsigned char)(lba >> 8));
+    outb(io_base + ATA_REGISTER_LBA_HIGH, (unsigned char)(lba >> 16));
+    outb(io_base + ATA_REGISTER_COMMAND, command);
+}
+
+static int read_sectors_in_single_command(struct ata_device* device, unsigned int lba, int total_num_blocks, void* buffer) {
+    uint16_t io_base = device->io_base;
+
+    send_sectors_command(device, lba, total_num_blocks, ATA_COMMAND_READ_SECTORS);
+
+    unsigned short* ptr = (unsigned short*) buffer;
+
+    for (int i = 0; i < total_num_blocks; ++i) {
+        // Wait for the disk buffer to be ready
+        if (wait_until_data_ready(io_base) != ALL_OK) {
+            return -IO_ERROR;
+        }
+
+        // Copy from HDD to memory
+        for (int j = 0; j < 256; ++j) {
+            *ptr = insw(io_base + ATA_REGISTER_DATA); // Read 2 bytes (1 word) a time
+            ptr++;
+        }
+    }
+
+    return 0;
+}
+
+// Same splitting as read. Drive may keep written sectors in its own cache,
+// so flush it after all sectors are sent, otherwise data can be lost on power off
+int ata_write_sectors(struct ata_device* device, unsigned int lba, int total_num_blocks, void* buffer) {
+    int result = 0;
+
+    while (total_num_blocks > 0) {
+        int current_num_blocks = total_num_blocks > ATA_MAX_SECTORS_PER_COMMAND ? ATA_MAX_SECTORS_PER_COMMAND : total_num_blocks;
+        result = write_sectors_in_single_command(device, lba, current_num_blocks, buffer);
+        if (result < 0) {
+            goto out;
+        }
+
+        lba += current_num_blocks;
+        buffer += current_num_blocks * DISK_SECTOR_SIZE;
+        total_num_blocks -= current_num_blocks;
+    }
+
+    result = flush_cache(device);
+
+out:
+    return result;
+}
+
+static int write_sectors_in_single_command(struct ata_device* device, unsigned int lba, int total_num_blocks, void* buffer) {
+    uint16_t io_base = device->io_base;
+
+    send_sectors_command(device, lba, total_num_blocks, ATA_COMMAND_WRITE_SECTORS);
+
+    unsigned short* ptr = (unsigned short*) buffer;
+
+    for (int i = 0; i < total_num_blocks; ++i) {
+        // Wait until drive is ready to accept next sector
+        if (wait_until_data_ready(io_base) != ALL_OK) {
+            return -IO_ERROR;
+        }
+
+        // Copy from memory to HDD
+        for (int j = 0; j < 256; ++j) {
+            outw(io_base + ATA_REGISTER_DATA, *ptr);
+            ptr++;
+        }
+    }
+
+    return 0;
+}
+
+static int flush_cache(struct ata_device* device) {
+    uint16_t io_base = device->io_base;
+
+    outb(io_base + ATA_REGISTER_DRIVE_SELECT, 0xE0 | (device->drive << 4));
+    wait_400ns(device->control_base);
+    outb(io_base + ATA_REGISTER_COMMAND, ATA_COMMAND_CACHE_FLUSH);
+
+    if (wait_until_not_busy(io_base) != ALL_OK) {
+        return -IO_ERROR;
+    }
+
+    if (insb(io_base + ATA_REGISTER_STATUS) & (ATA_STATUS_ERR | ATA_STATUS_DF)) {
+        return -IO_ERROR;
+    }
+
+    return 0;
+}
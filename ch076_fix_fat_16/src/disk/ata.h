@@ -0,0 +1,54 @@
+#ifndef ATA_H
+#define ATA_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// https://wiki.osdev.org/ATA_PIO_Mode
+// Legacy IDE controller has 2 channels, each channel can attach a master and a slave drive
+#define ATA_PRIMARY_IO_BASE 0x1F0
+#define ATA_PRIMARY_CONTROL_BASE 0x3F6
+#define ATA_SECONDARY_IO_BASE 0x170
+#define ATA_SECONDARY_CONTROL_BASE 0x376
+
+#define ATA_MASTER 0
+#define ATA_SLAVE 1
+
+// registers offset from IO base
+#define ATA_REGISTER_DATA 0
+#define ATA_REGISTER_ERROR 1
+#define ATA_REGISTER_SECTOR_COUNT 2
+#define ATA_REGISTER_LBA_LOW 3
+#define ATA_REGISTER_LBA_MID 4
+#define ATA_REGISTER_LBA_HIGH 5
+#define ATA_REGISTER_DRIVE_SELECT 6
+#define ATA_REGISTER_COMMAND 7 // status register when reading
+#define ATA_REGISTER_STATUS 7
+
+// status register bits
+#define ATA_STATUS_ERR 0x01
+#define ATA_STATUS_DRQ 0x08
+#define ATA_STATUS_DF 0x20
+#define ATA_STATUS_BSY 0x80
+
+#define ATA_COMMAND_READ_SECTORS 0x20
+#define ATA_COMMAND_WRITE_SECTORS 0x30
+#define ATA_COMMAND_CACHE_FLUSH 0xE7
+#define ATA_COMMAND_IDENTIFY 0xEC
+
+#define ATA_MAX_SECTORS_PER_COMMAND 256
+
+// a drive attached to legacy IDE channel
+struct ata_device {
+    uint16_t io_base;
+    uint16_t control_base;
+    uint8_t drive; // ATA_MASTER or ATA_SLAVE
+
+    uint32_t total_sectors;
+};
+
+int search_and_initialize_ata_devices(struct ata_device** devices, int max_devices);
+int ata_read_sectors(struct ata_device* device, unsigned int lba, int total_num_blocks, void* buffer);
+int ata_write_sectors(struct ata_device* device, unsigned int lba, int total_num_blocks, void* buffer);
+
+#endif
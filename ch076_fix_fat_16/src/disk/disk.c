@@ -1,61 +1,259 @@
 #include "disk.h"
-#include "io/io.h"
+#include "ata.h"
+#include "ahci.h"
+#include "disk_cache.h"
 #include "memory/memory.h"
 #include "config.h"
 #include "status.h"
+#include "kernel.h"
+#include "fs/ramfs/initramfs.h"
 
-struct disk disk;
+// registry of all detected disks. Disk ID is the index. Drive number in path (e.g. 1:/) is given separately on mount,
+// so drive numbers of physical disks don't depend on whether boot image exists
+struct disk disks[MAX_DISKS];
+int total_disks = 0;
+// drive number the next physical disk is mounted on
+static int next_physical_drive_num = FIRST_PHYSICAL_DRIVE_NUM;
 
-int read_sector_from_disk(int lba, int total_num_blocks, void* buffer);
+static void search_and_initialize_ata_disks();
+static void search_and_initialize_ahci_disks();
+static void initialize_scratch_disk();
+static void initialize_initramfs_disk();
+static void mount_disk_or_report(int drive_num, struct disk* disk);
+static void report_unmounted_disk(struct disk* disk);
+static struct disk* add_disk(DISK_TYPE disk_type, unsigned int total_sectors, void* driver_private_data);
+static int read_sectors_from_device(struct disk* target_disk, unsigned int lba, int total_num_blocks, void* buffer);
+static int write_sectors_to_device(struct disk* target_disk, unsigned int lba, int total_num_blocks, void* buffer);
 
 void search_and_initialize_disk() {
-    memset(&disk, 0, sizeof(disk));
-    disk.disk_type = DISK_TYPE_REAL;
-    disk.sector_size = DISK_SECTOR_SIZE;
-    disk.id = 0;
-    disk.filesystem = resolve_filesystem(&disk);
+    memset(disks, 0, sizeof(disks));
+    total_disks = 0;
+    next_physical_drive_num = FIRST_PHYSICAL_DRIVE_NUM;
+
+    // Boot image loaded by boot.asm is mounted on drive 0, so core programs on drive 0 start from memory.
+    // Then ATA, so primary master(boot disk) is always drive 1
+    initialize_initramfs_disk();
+    search_and_initialize_ata_disks();
+    search_and_initialize_ahci_disks();
+    initialize_scratch_disk();
+}
+
+// one registry slot is left for scratch disk
+static void search_and_initialize_ata_disks() {
+    struct ata_device* ata_devices[MAX_DISKS];
+    int total_ata_devices = search_and_initialize_ata_devices(ata_devices, MAX_DISKS - total_disks - 1);
+
+    for (int i = 0; i < total_ata_devices; i++) {
+        register_disk(DISK_TYPE_REAL, ata_devices[i]->total_sectors, ata_devices[i]);
+    }
+}
+
+static void search_and_initialize_ahci_disks() {
+    struct ahci_device* ahci_devices[MAX_DISKS];
+    int total_ahci_devices = search_and_initialize_ahci_devices(ahci_devices, MAX_DISKS - total_disks - 1);
+
+    for (int i = 0; i < total_ahci_devices; i++) {
+        register_disk(DISK_TYPE_AHCI, ahci_devices[i]->total_sectors, ahci_devices[i]);
+    }
+}
+
+// boot.asm leaves signature check to kernel, memory there is random if disk has no boot image
+static void initialize_initramfs_disk() {
+    struct initramfs_header* header = (struct initramfs_header*) INITRAMFS_ADDRESS;
+    if (header->signature != INITRAMFS_SIGNATURE || header->total_size > INITRAMFS_MAX_SIZE) {
+        return;
+    }
+
+    // ramfs resolved on the disk loads files of the image
+    struct disk* disk = add_disk(DISK_TYPE_MEMORY, (header->total_size + DISK_SECTOR_SIZE - 1) / DISK_SECTOR_SIZE, header);
+    if (disk) {
+        mount_disk_or_report(INITRAMFS_DRIVE_NUM, disk);
+    }
+}
+
+// ramfs on a fixed drive, so programs always know where to put temporary files
+static void initialize_scratch_disk() {
+    struct disk* disk = register_memory_disk();
+    if (disk) {
+        mount_disk_or_report(SCRATCH_DRIVE_NUM, disk);
+    }
+}
+
+// Add physical disk into registry, and mount filesystem on it to the next drive number.
+// Drive number is used up even if mount fails, so N-th detected disk is always on the same drive.
+// Each disk keeps its own filesystem and filesystem private data
+struct disk* register_disk(DISK_TYPE disk_type, unsigned int total_sectors, void* driver_private_data) {
+    struct disk* disk = add_disk(disk_type, total_sectors, driver_private_data);
+    if (!disk) {
+        return 0;
+    }
+
+    if (next_physical_drive_num == SCRATCH_DRIVE_NUM) {
+        next_physical_drive_num++;
+    }
+
+    if (next_physical_drive_num >= MAX_MOUNTS) {
+        report_unmounted_disk(disk);
+        return disk;
+    }
+
+    // disk should be accessible by get_disk before resolving, filesystem will stream it by disk ID
+    mount_disk_or_report(next_physical_drive_num, disk);
+    next_physical_drive_num++;
+
+    return disk;
+}
+
+// Disk without known filesystem or free drive stays unmounted, it can still be mounted later by disk ID
+static void mount_disk_or_report(int drive_num, struct disk* disk) {
+    if (mount_disk(drive_num, disk) != ALL_OK) {
+        report_unmounted_disk(disk);
+    }
+}
+
+static void report_unmounted_disk(struct disk* disk) {
+    // disk ID is a single digit since MAX_DISKS is 10
+    char message[] = "Disk 0 left unmounted\n";
+    message[5] = '0' + disk->id;
+    print(message);
+}
+
+// Disk without sectors for in-memory filesystem. Caller mounts it on the drive it wants
+struct disk* register_memory_disk() {
+    return add_disk(DISK_TYPE_MEMORY, 0, 0);
+}
+
+static struct disk* add_disk(DISK_TYPE disk_type, unsigned int total_sectors, void* driver_private_data) {
+    if (total_disks >= MAX_DISKS) {
+        return 0;
+    }
+
+    struct disk* disk = &disks[total_disks];
+    memset(disk, 0, sizeof(struct disk));
+    disk->disk_type = disk_type;
+    disk->sector_size = DISK_SECTOR_SIZE;
+    disk->total_sectors = total_sectors;
+    disk->id = total_disks;
+    disk->driver_private_data = driver_private_data;
+    total_disks++;
+
+    return disk;
+}
+
+int get_total_disks() {
+    return total_disks;
 }
 
 struct disk* get_disk(int index) {
-    if (index != 0)
+    if (index < 0 || index >= total_disks)
         return 0;
 
-    return &disk;
+    return &disks[index];
 }
 
-int read_disk_block(struct disk* target_disk, unsigned int lba, int total_num_blocks, void* buffer) {
-    if (target_disk != &disk) {
-        return -IO_ERROR;
+static int read_sectors_from_device(struct disk* target_disk, unsigned int lba, int total_num_blocks, void* buffer) {
+    int result = 0;
+
+    switch (target_disk->disk_type) {
+        case DISK_TYPE_REAL:
+            result = ata_read_sectors(target_disk->driver_private_data, lba, total_num_blocks, buffer);
+            break;
+        case DISK_TYPE_AHCI:
+            result = ahci_read_sectors(target_disk->driver_private_data, lba, total_num_blocks, buffer);
+            break;
+        default:
+            result = -IO_ERROR;
+            break;
     }
 
-    return read_sector_from_disk(lba, total_num_blocks, buffer);
+    return result;
 }
 
-// implement ata_lba_read in boot.asm in C lang
-int read_sector_from_disk(int lba, int total_num_blocks, void* buffer) {
-    outb(0x1F6, (lba>> 24) | 0xE0);
-    outb(0x1F2, total_num_blocks);
-    outb(0x1F3, (unsigned char)(lba & 0xff));
-    outb(0x1F4, (unsigned char)(lba >> 8));
-    outb(0x1F5, (unsigned char)(lba >> 16));
-    outb(0x1F7, 0x20);
+static int write_sectors_to_device(struct disk* target_disk, unsigned int lba, int total_num_blocks, void* buffer) {
+    int result = 0;
+
+    switch (target_disk->disk_type) {
+        case DISK_TYPE_REAL:
+            result = ata_write_sectors(target_disk->driver_private_data, lba, total_num_blocks, buffer);
+            break;
+        case DISK_TYPE_AHCI:
+            result = ahci_write_sectors(target_disk->driver_private_data, lba, total_num_blocks, buffer);
+            break;
+        default:
+            result = -IO_ERROR;
+            break;
+    }
+
+    return result;
+}
 
-    unsigned short* ptr = (unsigned short*) buffer;
+int read_disk_block(struct disk* target_disk, unsigned int lba, int total_num_blocks, void* buffer) {
+    struct disk_request request = {
+        .lba = lba,
+        .total_num_blocks = total_num_blocks,
+        .buffer = buffer,
+    };
 
-    for (int i = 0; i < total_num_blocks; ++i) {
-        // Wait for the disk buffer to be ready
-        // Means wait until read 0x08 from 0x1F7 port
-        char c = insb(0x1F7);
-        while (!(c & 0x08)) { // check until read flag set as 0x08
-            c = insb(0x1F7); // wait
+    return read_disk_requests(target_disk, &request, 1);
+}
+
+// Submit several runs at once. AHCI queues all of them together,
+// other drivers simply serve them one by one.
+// Sectors written but not flushed yet only exist in disk cache, so they are patched over what disk returns
+int read_disk_requests(struct disk* target_disk, struct disk_request* requests, int total_requests) {
+    int result = 0;
+
+    if (target_disk->disk_type == DISK_TYPE_AHCI) {
+        result = ahci_read_requests(target_disk->driver_private_data, requests, total_requests);
+    } else {
+        for (int i = 0; i < total_requests; i++) {
+            result = read_sectors_from_device(target_disk, requests[i].lba, requests[i].total_num_blocks, requests[i].buffer);
+            if (result < 0) {
+                break;
+            }
         }
+    }
+
+    if (result < 0) {
+        goto out;
+    }
+
+    apply_disk_cache(target_disk, requests, total_requests);
+
+out:
+    return result;
+}
+
+int write_disk_block(struct disk* target_disk, unsigned int lba, int total_num_blocks, void* buffer) {
+    struct disk_request request = {
+        .lba = lba,
+        .total_num_blocks = total_num_blocks,
+        .buffer = buffer,
+    };
+
+    return write_disk_requests(target_disk, &request, 1);
+}
+
+// Writes only go into disk cache, flush_disk_cache sends them to the device later
+int write_disk_requests(struct disk* target_disk, struct disk_request* requests, int total_requests) {
+    target_disk->write_generation++;
+    return write_to_disk_cache(target_disk, requests, total_requests);
+}
+
+// used by disk cache to write sectors back
+int write_disk_requests_to_device(struct disk* target_disk, struct disk_request* requests, int total_requests) {
+    int result = 0;
+
+    if (target_disk->disk_type == DISK_TYPE_AHCI) {
+        return ahci_write_requests(target_disk->driver_private_data, requests, total_requests);
+    }
 
-        // Copy from HDD to memory
-        for (int j = 0; j < 256; ++j) {
-            *ptr = insw(0x1F0); // Read 2 bytes (1 word) a time
-            ptr++;
+    for (int i = 0; i < total_requests; i++) {
+        result = write_sectors_to_device(target_disk, requests[i].lba, requests[i].total_num_blocks, requests[i].buffer);
+        if (result < 0) {
+            break;
         }
     }
 
-    return 0;
+    return result;
 }
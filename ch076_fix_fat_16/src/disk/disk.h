@@ -7,10 +7,16 @@ typedef unsigned int DISK_TYPE;
 
 // Real HDD
 #define DISK_TYPE_REAL 0
+// SATA drive behind AHCI controller
+#define DISK_TYPE_AHCI 1
+// no device behind, filesystem keeps everything in memory (e.g. ramfs).
+// driver_private_data points to boot image if the disk was made from one
+#define DISK_TYPE_MEMORY 2
 
 struct disk {
     DISK_TYPE disk_type;
     int sector_size;
+    unsigned int total_sectors;
 
     // Disk ID
     int id;
@@ -18,10 +24,30 @@ struct disk {
     struct filesystem* filesystem;
 
     void* filesystem_private_data;
+
+    // private data for disk driver, e.g. ata_device for ATA disk, ahci_device for AHCI disk
+    void* driver_private_data;
+
+    // increased on every write, so streams can tell their prefetched sectors may be stale
+    unsigned int write_generation;
+};
+
+// a run of continuous sectors to transfer with the given buffer
+struct disk_request {
+    unsigned int lba;
+    int total_num_blocks;
+    void* buffer;
 };
 
 void search_and_initialize_disk();
+struct disk* register_disk(DISK_TYPE disk_type, unsigned int total_sectors, void* driver_private_data);
+struct disk* register_memory_disk();
+int get_total_disks();
 struct disk* get_disk(int index);
 int read_disk_block(struct disk* target_disk, unsigned int lba, int total_num_blocks, void* buffer);
+int read_disk_requests(struct disk* target_disk, struct disk_request* requests, int total_requests);
+int write_disk_block(struct disk* target_disk, unsigned int lba, int total_num_blocks, void* buffer);
+int write_disk_requests(struct disk* target_disk, struct disk_request* requests, int total_requests);
+int write_disk_requests_to_device(struct disk* target_disk, struct disk_request* requests, int total_requests);
 
 #endif
@@ -0,0 +1,263 @@
+#include "disk_cache.h"
+#include "memory/heap/kheap.h"
+#include "memory/memory.h"
+#include "config.h"
+#include "status.h"
+#include <stdbool.h>
+
+struct disk_cache_block disk_cache_blocks[DISK_CACHE_TOTAL_BLOCKS];
+static uint32_t total_timer_ticks = 0;
+// set by timer interrupt, flush itself runs later outside of interrupt context
+static volatile bool is_flush_pending = false;
+
+// buffer continuous dirty sectors are copied into while flushing
+static char* flush_buffer = 0;
+
+static struct disk_cache_block* get_disk_cache_block(struct disk* target_disk, unsigned int first_sector);
+static struct disk_cache_block* find_disk_cache_block(struct disk* target_disk, unsigned int first_sector);
+static int flush_disk_cache_blocks(struct disk* target_disk);
+static int sort_dirty_blocks(struct disk* target_disk, struct disk_cache_block** blocks);
+static int submit_flush_requests(struct disk* target_disk, struct disk_request* requests, int total_requests);
+
+// Copy written sectors into cache blocks and mark them dirty. Nothing is sent to disk here,
+// unless cache is full and blocks must be flushed to make room
+int write_to_disk_cache(struct disk* target_disk, struct disk_request* requests, int total_requests) {
+    int result = 0;
+
+    for (int i = 0; i < total_requests; i++) {
+        unsigned int sector = requests[i].lba;
+        int rest_num_blocks = requests[i].total_num_blocks;
+        char* buffer = requests[i].buffer;
+
+        while (rest_num_blocks > 0) {
+            unsigned int offset_in_block = sector % DISK_CACHE_BLOCK_SECTORS;
+            int current_num_blocks = DISK_CACHE_BLOCK_SECTORS - offset_in_block;
+            if (current_num_blocks > rest_num_blocks) {
+                current_num_blocks = rest_num_blocks;
+            }
+
+            struct disk_cache_block* block = get_disk_cache_block(target_disk, sector - offset_in_block);
+            if (!block) {
+                result = -IO_ERROR;
+                goto out;
+            }
+
+            memcpy(block->data + offset_in_block * DISK_SECTOR_SIZE, buffer, current_num_blocks * DISK_SECTOR_SIZE);
+            block->dirty_sectors |= ((1 << current_num_blocks) - 1) << offset_in_block;
+
+            sector += current_num_blocks;
+            buffer += current_num_blocks * DISK_SECTOR_SIZE;
+            rest_num_blocks -= current_num_blocks;
+        }
+    }
+
+out:
+    return result;
+}
+
+// Dirty sectors are newer than what disk holds, copy them over sectors just read from disk
+void apply_disk_cache(struct disk* target_disk, struct disk_request* requests, int total_requests) {
+    for (int i = 0; i < DISK_CACHE_TOTAL_BLOCKS; i++) {
+        struct disk_cache_block* block = &disk_cache_blocks[i];
+        if (block->disk != target_disk || block->dirty_sectors == 0) {
+            continue;
+        }
+
+        for (int j = 0; j < total_requests; j++) {
+            unsigned int first_sector = requests[j].lba;
+            unsigned int end_sector = first_sector + requests[j].total_num_blocks;
+            if (block->first_sector >= end_sector || block->first_sector + DISK_CACHE_BLOCK_SECTORS <= first_sector) {
+                continue;
+            }
+
+            for (int k = 0; k < DISK_CACHE_BLOCK_SECTORS; k++) {
+                unsigned int sector = block->first_sector + k;
+                if (sector < first_sector || sector >= end_sector || !(block->dirty_sectors & (1 << k))) {
+                    continue;
+                }
+
+                memcpy((char*) requests[j].buffer + (sector - first_sector) * DISK_SECTOR_SIZE, block->data + k * DISK_SECTOR_SIZE, DISK_SECTOR_SIZE);
+            }
+        }
+    }
+}
+
+int flush_disk_cache(struct disk* target_disk) {
+    return flush_disk_cache_blocks(target_disk);
+}
+
+int flush_all_disk_caches() {
+    return flush_disk_cache_blocks(0);
+}
+
+// Called by timer interrupt, so dirty blocks are written back periodically and data doesn't stay in memory forever.
+// Only marks the flush as pending: polled disk writes of the whole cache are far too long for an interrupt handler
+void handle_disk_cache_timer_tick() {
+    total_timer_ticks++;
+    if (total_timer_ticks % DISK_CACHE_FLUSH_INTERVAL_TICKS != 0) {
+        return;
+    }
+
+    is_flush_pending = true;
+}
+
+// Called on the way back from a system call, where kernel is free to do polled disk I/O
+void run_pending_disk_cache_flush() {
+    if (!is_flush_pending) {
+        return;
+    }
+
+    is_flush_pending = false;
+    flush_all_disk_caches();
+}
+
+// Find cached block, or take a free one. When all blocks are dirty, all of them are flushed at once,
+// which is much cheaper than evicting and writing blocks one by one
+static struct disk_cache_block* get_disk_cache_block(struct disk* target_disk, unsigned int first_sector) {
+    struct disk_cache_block* block = find_disk_cache_block(target_disk, first_sector);
+    if (block) {
+        return block;
+    }
+
+    for (int i = 0; i < DISK_CACHE_TOTAL_BLOCKS; i++) {
+        if (!disk_cache_blocks[i].disk) {
+            block = &disk_cache_blocks[i];
+            break;
+        }
+    }
+
+    if (!block) {
+        if (flush_all_disk_caches() < 0) {
+            return 0;
+        }
+        block = &disk_cache_blocks[0];
+    }
+
+    if (!block->data) {
+        block->data = kzalloc(DISK_CACHE_BLOCK_SECTORS * DISK_SECTOR_SIZE);
+        if (!block->data) {
+            return 0;
+        }
+    }
+
+    block->disk = target_disk;
+    block->first_sector = first_sector;
+    block->dirty_sectors = 0;
+    return block;
+}
+
+static struct disk_cache_block* find_disk_cache_block(struct disk* target_disk, unsigned int first_sector) {
+    for (int i = 0; i < DISK_CACHE_TOTAL_BLOCKS; i++) {
+        struct disk_cache_block* block = &disk_cache_blocks[i];
+        if (block->disk == target_disk && block->first_sector == first_sector) {
+            return block;
+        }
+    }
+
+    return 0;
+}
+
+// Write dirty blocks of the disk(or every disk if target_disk is 0) back in sector order.
+// Continuous dirty sectors, even across blocks, are merged into a single request,
+// and several requests are submitted together so AHCI can queue them
+static int flush_disk_cache_blocks(struct disk* target_disk) {
+    int result = 0;
+    struct disk_cache_block* blocks[DISK_CACHE_TOTAL_BLOCKS];
+    struct disk_request requests[DISK_CACHE_MAX_FLUSH_REQUESTS];
+    int total_requests = 0;
+    int total_buffered_sectors = 0;
+    struct disk* current_disk = 0;
+
+    if (!flush_buffer) {
+        flush_buffer = kzalloc(DISK_CACHE_MAX_FLUSH_SECTORS * DISK_SECTOR_SIZE);
+        if (!flush_buffer) {
+            result = -NO_FREE_MEM_ERROR;
+            goto out;
+        }
+    }
+
+    int total_blocks = sort_dirty_blocks(target_disk, blocks);
+    for (int i = 0; i < total_blocks; i++) {
+        struct disk_cache_block* block = blocks[i];
+
+        for (int j = 0; j < DISK_CACHE_BLOCK_SECTORS; j++) {
+            if (!(block->dirty_sectors & (1 << j))) {
+                continue;
+            }
+
+            unsigned int sector = block->first_sector + j;
+            struct disk_request* last_request = total_requests > 0 ? &requests[total_requests - 1] : 0;
+            bool continues_last_request = last_request && current_disk == block->disk && last_request->lba + last_request->total_num_blocks == sector;
+
+            // submit what is collected so far if there is no room for this sector
+            if (block->disk != current_disk || total_buffered_sectors == DISK_CACHE_MAX_FLUSH_SECTORS || (!continues_last_request && total_requests == DISK_CACHE_MAX_FLUSH_REQUESTS)) {
+                result = submit_flush_requests(current_disk, requests, total_requests);
+                if (result < 0) {
+                    goto out;
+                }
+                total_requests = 0;
+                total_buffered_sectors = 0;
+                current_disk = block->disk;
+                continues_last_request = false;
+            }
+
+            char* buffer = flush_buffer + total_buffered_sectors * DISK_SECTOR_SIZE;
+            memcpy(buffer, block->data + j * DISK_SECTOR_SIZE, DISK_SECTOR_SIZE);
+            total_buffered_sectors++;
+
+            if (continues_last_request) {
+                requests[total_requests - 1].total_num_blocks++;
+            } else {
+                requests[total_requests].lba = sector;
+                requests[total_requests].total_num_blocks = 1;
+                requests[total_requests].buffer = buffer;
+                total_requests++;
+            }
+        }
+    }
+
+    result = submit_flush_requests(current_disk, requests, total_requests);
+    if (result < 0) {
+        goto out;
+    }
+
+    // everything is on disk now, blocks can be reused
+    for (int i = 0; i < total_blocks; i++) {
+        blocks[i]->disk = 0;
+        blocks[i]->dirty_sectors = 0;
+    }
+
+out:
+    return result;
+}
+
+// collect dirty blocks of the disk(or every disk) sorted by disk ID then sector, return num of blocks collected
+static int sort_dirty_blocks(struct disk* target_disk, struct disk_cache_block** blocks) {
+    int total_blocks = 0;
+
+    for (int i = 0; i < DISK_CACHE_TOTAL_BLOCKS; i++) {
+        struct disk_cache_block* block = &disk_cache_blocks[i];
+        if (!block->disk || block->dirty_sectors == 0 || (target_disk && block->disk != target_disk)) {
+            continue;
+        }
+
+        // insertion sort, there are only few blocks
+        int j = total_blocks;
+        while (j > 0 && (blocks[j - 1]->disk->id > block->disk->id || (blocks[j - 1]->disk == block->disk && blocks[j - 1]->first_sector > block->first_sector))) {
+            blocks[j] = blocks[j - 1];
+            j--;
+        }
+        blocks[j] = block;
+        total_blocks++;
+    }
+
+    return total_blocks;
+}
+
+static int submit_flush_requests(struct disk* target_disk, struct disk_request* requests, int total_requests) {
+    if (total_requests == 0) {
+        return ALL_OK;
+    }
+
+    return write_disk_requests_to_device(target_disk, requests, total_requests);
+}
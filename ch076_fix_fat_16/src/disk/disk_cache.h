@@ -0,0 +1,38 @@
+#ifndef DISK_CACHE_H
+#define DISK_CACHE_H
+
+#include "disk.h"
+#include <stdint.h>
+
+// Written sectors are kept in memory and written back later, so sectors written again and again
+// (FAT, directory items, tail of a growing file) reach the disk once.
+// Cache is made of blocks, each holds DISK_CACHE_BLOCK_SECTORS continuous sectors
+#define DISK_CACHE_BLOCK_SECTORS 8
+#define DISK_CACHE_TOTAL_BLOCKS 64
+
+// flush every 100 timer ticks, on the next system call return
+#define DISK_CACHE_FLUSH_INTERVAL_TICKS 100
+
+// flush copies continuous dirty sectors into staging buffer, then writes them in a single batch
+#define DISK_CACHE_MAX_FLUSH_SECTORS 128
+#define DISK_CACHE_MAX_FLUSH_REQUESTS 8
+
+struct disk_cache_block {
+    // 0 means block is not used
+    struct disk* disk;
+    unsigned int first_sector;
+
+    // bit n set if sector n of the block holds data not written to disk yet
+    uint8_t dirty_sectors;
+
+    char* data;
+};
+
+int write_to_disk_cache(struct disk* target_disk, struct disk_request* requests, int total_requests);
+void apply_disk_cache(struct disk* target_disk, struct disk_request* requests, int total_requests);
+int flush_disk_cache(struct disk* target_disk);
+int flush_all_disk_caches();
+void handle_disk_cache_timer_tick();
+void run_pending_disk_cache_flush();
+
+#endif
@@ -1,8 +1,13 @@
 #include "disk_stream.h"
 #include "memory/heap/kheap.h"
 #include "config.h"
+#include "memory/memory.h"
 #include <stdbool.h>
 
+static void update_read_ahead_window(struct disk_stream* stream);
+static int read_from_read_ahead_buffer(struct disk_stream* stream, void* output, int total_bytes_to_read);
+static int get_total_read_ahead_sectors(struct disk_stream* stream, int start_sector);
+
 struct disk_stream* create_disk_stream(int disk_id) {
     struct disk* target_disk = get_disk(disk_id);
     if (!target_disk) {
@@ -12,6 +17,7 @@ struct disk_stream* create_disk_stream(int disk_id) {
     struct disk_stream* target_stream = kzalloc(sizeof(struct disk_stream));
     target_stream->position = 0;
     target_stream->target_disk = target_disk;
+    target_stream->last_end_position = -1;
     return target_stream;
 }
 
@@ -20,45 +26,253 @@ int set_disk_stream_position(struct disk_stream* stream, int position) {
     return 0;
 }
 
+// Grow window while stream keeps reading sequentially. Any jump turns read-ahead off
+static void update_read_ahead_window(struct disk_stream* stream) {
+    if (stream->position != stream->last_end_position) {
+        stream->read_ahead_window = 0;
+        return;
+    }
+
+    if (stream->read_ahead_window == 0) {
+        stream->read_ahead_window = DISK_STREAM_INITIAL_READ_AHEAD_SECTORS;
+    } else if (stream->read_ahead_window < DISK_STREAM_MAX_READ_AHEAD_SECTORS) {
+        stream->read_ahead_window *= 2;
+    }
+
+    if (!stream->read_ahead_buffer) {
+        stream->read_ahead_buffer = kzalloc(DISK_STREAM_MAX_READ_AHEAD_SECTORS * DISK_SECTOR_SIZE);
+        if (!stream->read_ahead_buffer) {
+            stream->read_ahead_window = 0;
+        }
+    }
+}
+
+// Copy leading part of the read which is already prefetched. Return num of bytes copied
+static int read_from_read_ahead_buffer(struct disk_stream* stream, void* output, int total_bytes_to_read) {
+    int buffer_start_position = stream->read_ahead_start_sector * DISK_SECTOR_SIZE;
+    int buffer_end_position = buffer_start_position + stream->read_ahead_total_sectors * DISK_SECTOR_SIZE;
+
+    if (stream->read_ahead_write_generation != stream->target_disk->write_generation) {
+        stream->read_ahead_total_sectors = 0;
+    }
+
+    if (stream->read_ahead_total_sectors == 0 || stream->position < buffer_start_position || stream->position >= buffer_end_position) {
+        return 0;
+    }
+
+    int total_bytes_copied = buffer_end_position - stream->position;
+    if (total_bytes_copied > total_bytes_to_read) {
+        total_bytes_copied = total_bytes_to_read;
+    }
+
+    memcpy(output, stream->read_ahead_buffer + (stream->position - buffer_start_position), total_bytes_copied);
+    stream->position += total_bytes_copied;
+
+    return total_bytes_copied;
+}
+
+// never prefetch beyond end of disk, drive rejects the whole command otherwise
+static int get_total_read_ahead_sectors(struct disk_stream* stream, int start_sector) {
+    int total_sectors = stream->read_ahead_window;
+    int total_disk_sectors = stream->target_disk->total_sectors;
+
+    if (start_sector >= total_disk_sectors) {
+        return 0;
+    }
+
+    if (start_sector + total_sectors > total_disk_sectors) {
+        total_sectors = total_disk_sectors - start_sector;
+    }
+
+    return total_sectors;
+}
+
+// Serve what previous read-ahead already fetched, then plan rest of the read as at most 3 runs and submit them together:
+// 1. unaligned head sector, through bounce buffer
+// 2. sector aligned middle sectors, directly into caller's buffer
+// 3. read-ahead sectors(starting from unaligned tail sector if any) into read-ahead buffer,
+//    or only unaligned tail sector through bounce buffer if stream is not sequential
+// No recursion, so stack usage stays constant no matter how large the read is.
+// Drivers are polling based, so prefetch is submitted along with the demanded sectors.
+// AHCI with NCQ queues it as a separate command, then device works on both at the same time
 int read_from_disk_stream(struct disk_stream* stream, void* output, int target_total_bytes_to_read) {
-    int sector = stream->position / DISK_SECTOR_SIZE;
+    int result = 0;
+    struct disk_request requests[DISK_STREAM_MAX_RUNS];
+    int total_requests = 0;
+    char bounce_buffer[2 * DISK_SECTOR_SIZE]; // first half for head sector, second half for tail sector
+
+    if (target_total_bytes_to_read <= 0) {
+        goto out;
+    }
+
+    update_read_ahead_window(stream);
+
+    int total_bytes_copied = read_from_read_ahead_buffer(stream, output, target_total_bytes_to_read);
+    output += total_bytes_copied;
+    target_total_bytes_to_read -= total_bytes_copied;
+    if (target_total_bytes_to_read == 0) {
+        goto out;
+    }
+
+    int first_sector = stream->position / DISK_SECTOR_SIZE;
     int offset = stream->position % DISK_SECTOR_SIZE;
-    int current_total_bytes_to_read = target_total_bytes_to_read;
+    int last_sector = (stream->position + target_total_bytes_to_read - 1) / DISK_SECTOR_SIZE;
+    int bytes_in_last_sector = (stream->position + target_total_bytes_to_read) % DISK_SECTOR_SIZE; // 0 means whole sector
+
+    int first_direct_sector = first_sector;
+    int last_direct_sector = last_sector;
+    bool bounce_head = offset != 0 || (first_sector == last_sector && bytes_in_last_sector != 0);
+    bool need_tail = false;
+
+    if (bounce_head) {
+        requests[total_requests].lba = first_sector;
+        requests[total_requests].total_num_blocks = 1;
+        requests[total_requests].buffer = bounce_buffer;
+        total_requests++;
+        first_direct_sector++;
+    }
 
-    // if current_offset + total_byte_to_read finally exceeds disk sector size,
-    // it means buffer size will be overflow --> buffer size if sector size only
-    // and unexpected memory will be accessed --> malicious code
-    bool overflow = (offset + target_total_bytes_to_read) >= DISK_SECTOR_SIZE;
+    if (last_sector >= first_direct_sector && bytes_in_last_sector != 0) {
+        need_tail = true;
+        last_direct_sector--;
+    }
 
-    if (overflow) {
-        current_total_bytes_to_read -= (offset + target_total_bytes_to_read) - DISK_SECTOR_SIZE;
+    if (last_direct_sector >= first_direct_sector) {
+        requests[total_requests].lba = first_direct_sector;
+        requests[total_requests].total_num_blocks = last_direct_sector - first_direct_sector + 1;
+        requests[total_requests].buffer = output + (first_direct_sector * DISK_SECTOR_SIZE - stream->position);
+        total_requests++;
     }
 
-    char buffer[DISK_SECTOR_SIZE]; // set buffer size
+    // read-ahead buffer is going to be overwritten
+    stream->read_ahead_total_sectors = 0;
+    int read_ahead_start_sector = need_tail ? last_sector : last_sector + 1;
+    int total_read_ahead_sectors = get_total_read_ahead_sectors(stream, read_ahead_start_sector);
 
-    int result = read_disk_block(stream->target_disk, sector, 1, buffer);
+    if (total_read_ahead_sectors > 0) {
+        requests[total_requests].lba = read_ahead_start_sector;
+        requests[total_requests].total_num_blocks = total_read_ahead_sectors;
+        requests[total_requests].buffer = stream->read_ahead_buffer;
+        total_requests++;
+    } else if (need_tail) {
+        requests[total_requests].lba = last_sector;
+        requests[total_requests].total_num_blocks = 1;
+        requests[total_requests].buffer = bounce_buffer + DISK_SECTOR_SIZE;
+        total_requests++;
+    }
+
+    result = read_disk_requests(stream->target_disk, requests, total_requests);
     if (result < 0) {
         goto out;
     }
 
-    // Prevent load more data(overflow) than buffer's capacity
-    // Means load data under buffer size a time
-    for (int i = 0; i < current_total_bytes_to_read; i++) {
-        *(char*)output++ = buffer[offset+i];
+    if (bounce_head) {
+        int head_bytes = DISK_SECTOR_SIZE - offset;
+        if (head_bytes > target_total_bytes_to_read) {
+            head_bytes = target_total_bytes_to_read;
+        }
+        memcpy(output, bounce_buffer + offset, head_bytes);
+    }
+
+    if (total_read_ahead_sectors > 0) {
+        stream->read_ahead_start_sector = read_ahead_start_sector;
+        stream->read_ahead_total_sectors = total_read_ahead_sectors;
+        stream->read_ahead_write_generation = stream->target_disk->write_generation;
     }
 
-    // Adjust stream, and load rest of bytes
-    // Recursive call
-    stream->position += current_total_bytes_to_read;
-    // Read haven't finished, still have bytes not read
-    if (overflow) {
-        result = read_from_disk_stream(stream, output, target_total_bytes_to_read - current_total_bytes_to_read);
+    if (need_tail) {
+        char* tail_sector = total_read_ahead_sectors > 0 ? stream->read_ahead_buffer : bounce_buffer + DISK_SECTOR_SIZE;
+        memcpy(output + target_total_bytes_to_read - bytes_in_last_sector, tail_sector, bytes_in_last_sector);
     }
 
+    stream->position += target_total_bytes_to_read;
+
 out:
+    stream->last_end_position = stream->position;
+    return result;
+}
+
+// Disk only accepts whole sectors, so unaligned head and tail sectors are read first,
+// patched in bounce buffer, then written back together with aligned middle sectors(directly from caller's buffer)
+int write_to_disk_stream(struct disk_stream* stream, const void* input, int target_total_bytes_to_write) {
+    int result = 0;
+    struct disk_request requests[DISK_STREAM_MAX_RUNS];
+    int total_requests = 0;
+    char bounce_buffer[2 * DISK_SECTOR_SIZE]; // first half for head sector, second half for tail sector
+
+    if (target_total_bytes_to_write <= 0) {
+        goto out;
+    }
+
+    int first_sector = stream->position / DISK_SECTOR_SIZE;
+    int offset = stream->position % DISK_SECTOR_SIZE;
+    int last_sector = (stream->position + target_total_bytes_to_write - 1) / DISK_SECTOR_SIZE;
+    int bytes_in_last_sector = (stream->position + target_total_bytes_to_write) % DISK_SECTOR_SIZE; // 0 means whole sector
+
+    int first_direct_sector = first_sector;
+    int last_direct_sector = last_sector;
+    bool bounce_head = offset != 0 || (first_sector == last_sector && bytes_in_last_sector != 0);
+    bool bounce_tail = false;
+
+    if (bounce_head) {
+        requests[total_requests].lba = first_sector;
+        requests[total_requests].total_num_blocks = 1;
+        requests[total_requests].buffer = bounce_buffer;
+        total_requests++;
+        first_direct_sector++;
+    }
+
+    if (last_sector >= first_direct_sector && bytes_in_last_sector != 0) {
+        requests[total_requests].lba = last_sector;
+        requests[total_requests].total_num_blocks = 1;
+        requests[total_requests].buffer = bounce_buffer + DISK_SECTOR_SIZE;
+        total_requests++;
+        bounce_tail = true;
+        last_direct_sector--;
+    }
+
+    if (total_requests > 0) {
+        result = read_disk_requests(stream->target_disk, requests, total_requests);
+        if (result < 0) {
+            goto out;
+        }
+    }
+
+    if (bounce_head) {
+        int head_bytes = DISK_SECTOR_SIZE - offset;
+        if (head_bytes > target_total_bytes_to_write) {
+            head_bytes = target_total_bytes_to_write;
+        }
+        memcpy(bounce_buffer + offset, (void*) input, head_bytes);
+    }
+
+    if (bounce_tail) {
+        memcpy(bounce_buffer + DISK_SECTOR_SIZE, (void*) input + target_total_bytes_to_write - bytes_in_last_sector, bytes_in_last_sector);
+    }
+
+    if (last_direct_sector >= first_direct_sector) {
+        requests[total_requests].lba = first_direct_sector;
+        requests[total_requests].total_num_blocks = last_direct_sector - first_direct_sector + 1;
+        requests[total_requests].buffer = (void*) input + (first_direct_sector * DISK_SECTOR_SIZE - stream->position);
+        total_requests++;
+    }
+
+    result = write_disk_requests(stream->target_disk, requests, total_requests);
+    if (result < 0) {
+        goto out;
+    }
+
+    stream->position += target_total_bytes_to_write;
+
+out:
+    // writing breaks sequential reading
+    stream->last_end_position = -1;
     return result;
 }
 
 void close_disk_stream(struct disk_stream* stream) {
+    if (stream->read_ahead_buffer) {
+        kfree(stream->read_ahead_buffer);
+    }
     kfree(stream);
-}
\ No newline at end of file
+}
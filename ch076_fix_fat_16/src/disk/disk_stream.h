@@ -3,14 +3,35 @@
 
 #include "disk.h"
 
+// head, middle and tail(or read-ahead) of a read
+#define DISK_STREAM_MAX_RUNS 3
+
+// read-ahead window starts from 8 sectors(4KB) once sequential access detected,
+// then doubles on every sequential read, until 128 sectors(64KB)
+#define DISK_STREAM_INITIAL_READ_AHEAD_SECTORS 8
+#define DISK_STREAM_MAX_READ_AHEAD_SECTORS 128
+
 struct disk_stream {
     int position;
     struct disk* target_disk;
+
+    // position previous read ended at. Read starts from there means sequential access
+    int last_end_position;
+    // num of sectors to prefetch after current read. 0 for random access
+    int read_ahead_window;
+
+    // sectors prefetched by previous read
+    char* read_ahead_buffer;
+    int read_ahead_start_sector;
+    int read_ahead_total_sectors;
+    // disk write generation when sectors were prefetched. Buffer is dropped once disk got written since then
+    unsigned int read_ahead_write_generation;
 };
 
 struct disk_stream* create_disk_stream(int disk_id);
 int set_disk_stream_position(struct disk_stream* stream, int position);
 int read_from_disk_stream(struct disk_stream* stream, void* output, int target_total_bytes_to_read);
+int write_to_disk_stream(struct disk_stream* stream, const void* input, int target_total_bytes_to_write);
 void close_disk_stream(struct disk_stream* stream);
 
 #endif
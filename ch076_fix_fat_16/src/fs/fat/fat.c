@@ -0,0 +1,2792 @@
+#include "fat.h"
+#include "status.h"
+#include "config.h"
+#include "string/string.h"
+#include "disk/disk.h"
+#include "disk/disk_stream.h"
+#include "memory/memory.h"
+#include "memory/heap/kheap.h"
+#include "kernel.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+// shared by FAT16 and FAT32
+#define FAT_UNUSED 0x00
+// root directory has no cluster, 0 is never a valid data cluster
+#define FAT_ROOT_DIRECTORY_CLUSTER 0
+#define FAT_FIRST_DATA_CLUSTER 2
+// extra clusters reserved whenever a file grows, keeps appended data continuous
+#define FAT_PREALLOCATE_CLUSTERS 16
+// disk stream positions and absolute byte offsets are int, so the whole volume must stay below 2GiB
+#define FAT_MAX_VOLUME_BYTES 0x7FFFFFFF
+
+#define FAT16_SIGNATURE 0x29
+#define FAT16_FAT_ENTRY_SIZE 0x02
+#define FAT16_BAD_SECTOR 0xFFF7
+// 0xFFF0-0xFFF6 are reserved, 0xFFF8-0xFFFF mark end of cluster chain
+#define FAT16_RESERVED_CLUSTER_START 0xFFF0
+#define FAT16_END_OF_CHAIN 0xFFF8
+
+#define FAT32_SIGNATURE 0x29
+#define FAT32_FAT_ENTRY_SIZE 0x04
+// top 4 bits of FAT32 entry are reserved, cluster number is 28 bits
+#define FAT32_CLUSTER_MASK 0x0FFFFFFF
+#define FAT32_BAD_SECTOR 0x0FFFFFF7
+#define FAT32_RESERVED_CLUSTER_START 0x0FFFFFF0
+#define FAT32_END_OF_CHAIN 0x0FFFFFF8
+#define FAT32_FS_INFO_LEAD_SIGNATURE 0x41615252
+#define FAT32_FS_INFO_STRUCT_SIGNATURE 0x61417272
+#define FAT32_FS_INFO_TRAIL_SIGNATURE 0xAA550000
+
+#define FAT_DELETED_ITEM 0xE5
+#define FAT_SHORT_NAME_LENGTH 11
+#define FAT_MIN_NAME_INDEX_SIZE 16
+#define FAT_EMPTY_NAME_INDEX -1
+
+#define FAT_DENTRY_CACHE_SIZE 64
+// LFN allows 255 characters
+#define FAT_DENTRY_NAME_LENGTH 256
+
+// VFAT long filename
+#define FAT_LONG_NAME_CHARACTERS_PER_ITEM 13
+#define FAT_MAX_LONG_NAME_ITEMS 20
+#define FAT_LAST_LONG_NAME_ITEM 0x40
+#define FAT_LONG_NAME_ORDER_MASK 0x1F
+#define FAT_NO_LONG_NAME -1
+#define FAT_INITIAL_LONG_NAMES_SIZE 4096
+
+typedef unsigned int FAT_TYPE;
+#define FAT_TYPE_FAT16 0
+#define FAT_TYPE_FAT32 1
+
+// FAT file type
+typedef unsigned int FAT_ITEM_TYPE;
+#define FAT_ITEM_TYPE_DIRECTORY 0
+#define FAT_ITEM_TYPE_FILE 1
+
+// FAT directory entry attributes bitmask
+#define FAT_FILE_READ_ONLY 0x01
+#define FAT_FILE_HIDDEN 0x02
+#define FAT_FILE_SYSTEM 0X04
+#define FAT_FILE_VOLUME_LABEL 0x08
+#define FAT_FILE_SUBDIRECTORY 0x10
+#define FAT_FILE_ARCHIVED 0x20
+#define FAT_FILE_DEVICE 0x40
+#define FAT_FILE_RESERVED 0x80
+// read only, hidden, system and volume label at the same time marks a LFN item
+#define FAT_FILE_LONG_NAME 0x0F
+
+
+// represent FAT header information in boot.asm
+struct extended_fat_header {
+    uint8_t drive_number;
+    uint8_t win_nt_bit;
+    uint8_t signature;
+    uint32_t volume_id;
+    uint8_t volume_id_string[11];
+    uint8_t system_id_string[8];
+} __attribute__((packed));
+
+struct primary_fat_header {
+    uint8_t short_jmp_instruction[3];
+    uint8_t oem_identifier[8];
+    uint16_t bytes_per_sector;
+    uint8_t sectors_per_cluster;
+    uint16_t reserved_sectors;
+    uint8_t fat_copies;
+    uint16_t root_dir_entries;
+    uint16_t num_of_sectors;
+    uint8_t media_type;
+    uint16_t sectors_per_fat;
+    uint16_t sectors_per_track;
+    uint16_t number_of_heads;
+    uint32_t hidden_sectors;
+    uint32_t sectors_big;
+} __attribute__((packed));
+
+// FAT32 has no fixed root directory. 16 bit sectors_per_fat and root_dir_entries are 0,
+// and these fields come before extended header instead
+struct fat32_extended_header {
+    uint32_t sectors_per_fat;
+    uint16_t flags;
+    uint16_t version;
+    uint32_t root_directory_cluster;
+    uint16_t fs_info_sector;
+    uint16_t backup_boot_sector;
+    uint8_t reserved[12];
+    struct extended_fat_header extended_header;
+} __attribute__((packed));
+
+struct fat_header {
+    struct primary_fat_header primary_fat_header;
+    // extended header is optional, so make this field union
+    union extended_fat_header_union {
+        struct extended_fat_header extended_header;
+        struct fat32_extended_header fat32_extended_header;
+    } shared;
+};
+
+// FAT32 FSInfo sector. Free cluster count and next free cluster are only hints, 0xFFFFFFFF if unknown
+struct fat32_fs_info {
+    uint32_t lead_signature;
+    uint8_t reserved[480];
+    uint32_t struct_signature;
+    uint32_t free_cluster_count;
+    uint32_t next_free_cluster;
+    uint8_t reserved_2[12];
+    uint32_t trail_signature;
+} __attribute__((packed));
+
+// represents "file"
+struct fat_directory_item {
+    uint8_t filename[8];
+    uint8_t extension[3];
+    uint8_t attribute; // FAT directory entry attributes bitmask
+    uint8_t reserved;
+    uint8_t creation_time_tenth_of_a_sec;
+    uint16_t creation_time;
+    uint16_t creation_date;
+    uint16_t last_access;
+    uint16_t high_16_bits_of_first_cluster;
+    uint16_t last_modified_time;
+    uint16_t last_modified_date;
+    uint16_t low_16_bits_of_first_cluster;
+    uint32_t filesize;
+} __attribute((packed));
+
+// VFAT long filename item, stored in place of a directory item. Holds 13 characters of the long name
+struct fat_long_name_item {
+    uint8_t order; // 1 based position of this part of the name
+    uint16_t name_part_1[5];
+    uint8_t attribute; // always FAT_FILE_LONG_NAME
+    uint8_t type;
+    uint8_t checksum; // checksum of short name the long name belongs to
+    uint16_t name_part_2[6];
+    uint16_t first_cluster; // always 0
+    uint16_t name_part_3[2];
+} __attribute((packed));
+
+// represents "directory"
+struct fat_directory {
+    struct fat_directory_item* item;
+    int total_num_of_items;
+    int start_sector_position;
+    int end_sector_position;
+
+    // hash table of item indexes keyed by short name and long name, built once directory loaded
+    int* name_index;
+    int name_index_size;
+
+    // decoded long names of all items in one buffer. long_name_offsets[i] is offset of i-th item's name in it,
+    // FAT_NO_LONG_NAME if the item has no long name
+    char* long_names;
+    int long_names_size;
+    int* long_name_offsets;
+
+    // deleted and LFN items are dropped while loading, item_slots[i] keeps where i-th item lives on disk
+    int* item_slots;
+};
+
+// represents fat entry. can be file or directory
+struct fat_item {
+    union {
+        struct fat_directory_item* item;
+        struct fat_directory* directory;
+    };
+
+    FAT_ITEM_TYPE item_type;
+};
+
+// Cached result of looking up a name under a directory.
+// Negative dentry records the name doesn't exist, so repeated misses do no directory search either
+struct fat_dentry {
+    bool in_use;
+    bool negative;
+
+    // first cluster of parent directory, FAT_ROOT_DIRECTORY_CLUSTER for root directory
+    uint32_t parent_cluster;
+    char name[FAT_DENTRY_NAME_LENGTH];
+
+    struct fat_directory_item item;
+    // slot of the item in parent directory, locates the item on disk
+    int item_slot;
+    // loaded contents if item is a subdirectory, owned by the cache
+    struct fat_directory* directory;
+
+    // for LRU eviction
+    uint32_t last_used;
+};
+
+struct fat_private_data {
+    struct fat_header header;
+    struct fat_directory root_directory;
+
+    // FAT16 and FAT32 differ only in on-disk layout, which is described here once filesystem is resolved
+    FAT_TYPE fat_type;
+    uint32_t sectors_per_fat;
+    uint32_t first_data_sector;
+    // FAT_ROOT_DIRECTORY_CLUSTER for FAT16 fixed root directory, first cluster of root directory chain for FAT32
+    uint32_t root_directory_cluster;
+    uint32_t fat_entry_size;
+    uint32_t reserved_cluster_start;
+    uint32_t bad_cluster;
+    uint32_t end_of_chain;
+
+    // used to stream data clusters
+    struct disk_stream* cluster_read_stream;
+    // used to stream file allocation table
+    struct disk_stream* fat_read_stream;
+
+    // used to stream directory
+    struct disk_stream* directory_stream;
+
+    // used to write data clusters, FAT and directory items
+    struct disk_stream* write_stream;
+
+    // whole first FAT copy, loaded while resolving filesystem. Cluster chain lookup becomes array indexing.
+    // 16 or 32 bit entries depending on FAT type, accessed through get_cached_fat_entry and set_cached_fat_entry
+    void* fat_table;
+    uint32_t total_fat_entries;
+
+    // 1 bit per cluster, set if the cluster is used. Built from cached FAT while resolving filesystem
+    uint8_t* free_cluster_bitmap;
+    // valid data clusters are FAT_FIRST_DATA_CLUSTER to total_clusters - 1
+    uint32_t total_clusters;
+    // allocation starts searching from here, clusters before it are most likely used
+    uint32_t next_free_cluster_hint;
+    uint32_t total_free_clusters;
+
+    // FAT32 FSInfo sector, 0 if the filesystem has none. Hints are written back on close once they changed
+    uint32_t fs_info_sector;
+    bool is_fs_info_dirty;
+
+    // bounded number of resolved path components, least recently used one is evicted when full
+    struct fat_dentry dentry_cache[FAT_DENTRY_CACHE_SIZE];
+    uint32_t dentry_cache_tick;
+};
+
+// represents opened directory. Holds its own copy of the directory, so later changes or cache eviction never affect it
+struct fat_directory_descriptor {
+    struct fat_directory* directory;
+    int next_item_index; // item returned by next read
+};
+
+// last resolved position in a cluster chain
+struct fat_cluster_cursor {
+    int cluster_index; // n-th cluster of the chain
+    int cluster; // cluster number, 0 means nothing cached yet
+};
+
+// represents opened file
+struct fat_file_descriptor {
+    struct fat_item* item;
+    FILE_POSITION position; // current position of file pointer
+
+    // cluster last read, so continuing read/seek resumes from there instead of first cluster
+    struct fat_cluster_cursor cursor;
+
+    FILE_MODE mode;
+    // where directory item of the file lives, so file size and first cluster can be written back
+    uint32_t parent_cluster;
+    int item_slot;
+
+    // disk the file lives on, close needs it to release preallocated clusters
+    struct disk* disk;
+    bool has_preallocated_clusters;
+};
+
+int resolve_fat16_filesystem(struct disk* disk);
+int resolve_fat32_filesystem(struct disk* disk);
+static int resolve_fat_filesystem(struct disk* disk, struct filesystem* filesystem, FAT_TYPE fat_type);
+static int initialize_fat_layout(struct disk* disk, struct fat_private_data* private_data, FAT_TYPE fat_type);
+static int read_fs_info(struct disk* disk, struct fat_private_data* private_data);
+static int write_fs_info(struct disk* disk);
+static void free_fat_private_data(struct disk* disk);
+int fat_unmount(struct disk* disk);
+void* fat_open(struct disk* disk, struct path_part* path, FILE_MODE mode);
+
+static void initialize_fat_private_data(struct disk* disk, struct fat_private_data* private_data);
+
+int get_fat_root_directory(struct disk* disk, struct fat_private_data* fat_private, struct fat_directory* directory);
+int convert_sector_to_absolute_byte(struct disk* disk, int sector);
+
+static int open_file_for_writing(struct disk* disk, struct fat_file_descriptor* descriptor, struct path_part* path, FILE_MODE mode);
+static int create_file(struct disk* disk, uint32_t parent_cluster, const char* name, struct fat_directory_item* item);
+static int truncate_file(struct disk* disk, struct fat_file_descriptor* descriptor);
+static int extend_file(struct disk* disk, struct fat_file_descriptor* descriptor, uint32_t size);
+static int release_preallocated_clusters(struct disk* disk, struct fat_file_descriptor* descriptor);
+
+struct fat_item* get_directory_entry(struct disk* disk, struct path_part* path);
+static struct fat_directory* get_parent_directory(struct disk* disk, struct path_part* path, uint32_t* parent_cluster, struct path_part** last_part);
+struct fat_directory_item* find_item_in_directory(struct fat_directory* directory, const char* name);
+static bool convert_name_to_short_name(const char* name, uint8_t* short_name);
+static void get_short_name_of_item(struct fat_directory_item* item, uint8_t* short_name);
+static uint32_t hash_short_name(uint8_t* short_name);
+static int index_directory_items(struct fat_directory* directory, struct fat_directory_item* items, int total_slots);
+static int add_item_to_name_index(struct fat_directory* directory, int item_index);
+static int resize_name_index(struct fat_directory* directory, int index_size);
+static void insert_item_into_name_index(struct fat_directory* directory, int item_index);
+static void copy_long_name_characters(struct fat_long_name_item* long_name_item, char* out);
+static uint8_t get_short_name_checksum(struct fat_directory_item* item);
+static int append_long_name(struct fat_directory* directory, int* long_names_capacity, const char* long_name);
+static const char* get_long_name_of_item(struct fat_directory* directory, int item_index);
+static uint32_t hash_long_name(const char* long_name);
+static void insert_into_name_index(struct fat_directory* directory, uint32_t hash, int item_index);
+static struct fat_directory_item* find_item_by_long_name(struct fat_directory* directory, const char* long_name);
+static struct fat_directory_item* find_item_by_short_name(struct fat_directory* directory, const char* name);
+static void free_directory_contents(struct fat_directory* directory);
+static struct fat_dentry* get_dentry(struct disk* disk, struct fat_directory* parent_directory, uint32_t parent_cluster, const char* name);
+static struct fat_dentry* find_dentry(struct fat_private_data* private_data, uint32_t parent_cluster, const char* name);
+static struct fat_dentry* allocate_dentry(struct fat_private_data* private_data);
+static void release_dentry(struct fat_dentry* dentry);
+static struct fat_directory* get_dentry_directory(struct disk* disk, struct fat_dentry* dentry);
+static int invalidate_directory_cache(struct disk* disk, uint32_t directory_cluster);
+static void update_cached_directory_item(struct disk* disk, uint32_t directory_cluster, int item_slot, struct fat_directory_item* item);
+static int get_directory_item_position(struct disk* disk, uint32_t directory_cluster, int item_slot);
+static int write_directory_item(struct disk* disk, uint32_t directory_cluster, int item_slot, struct fat_directory_item* item);
+static int find_free_directory_slot(struct disk* disk, uint32_t directory_cluster);
+static int extend_directory(struct disk* disk, uint32_t directory_cluster);
+static uint32_t get_directory_chain_cluster(struct fat_private_data* private_data, uint32_t directory_cluster);
+static int read_directory_clusters(struct disk* disk, uint32_t cluster, struct fat_directory* directory);
+void get_full_relative_filename(struct fat_directory_item* item, char* out, int max_len);
+void remove_spaces(char** out, const char* in, size_t size);
+struct fat_item* new_fat_item_for_dentry(struct disk* disk, struct fat_dentry* dentry);
+struct fat_directory* load_fat_directory(struct disk* disk, struct fat_directory_item* directory_item);
+static uint32_t get_first_cluster(struct fat_directory_item* directory_item);
+static void set_first_cluster(struct fat_directory_item* directory_item, uint32_t cluster);
+static int convert_cluster_to_sector(struct fat_private_data* private_data, int cluster);
+static int read_data_from_cluster(struct disk* disk, int starting_cluster, int offset, int total_bytes_to_read, void* out);
+static int read_data_from_file(struct disk* disk, struct fat_file_descriptor* descriptor, FILE_POSITION offset, int total_bytes_to_read, void* out);
+static int write_data_to_file(struct disk* disk, struct fat_file_descriptor* descriptor, FILE_POSITION offset, int total_bytes_to_write, const void* in);
+static int transfer_data_via_disk_stream(struct disk* disk, struct disk_stream* stream, struct fat_cluster_cursor* cursor, int cluster, FILE_POSITION offset, int total_bytes, void* buffer, bool write);
+static int get_cluster_via_cursor(struct disk* disk, struct fat_cluster_cursor* cursor, int starting_cluster, int cluster_index);
+static int get_total_continuous_clusters(struct disk* disk, int cluster, int max_clusters);
+static int get_cluster_based_on_offset(struct disk* disk, int starting_cluster, int offset);
+static int get_total_clusters_in_chain(struct disk* disk, int cluster, int* last_cluster);
+static int get_fat_entry(struct disk* disk, int cluster);
+static int set_fat_entry(struct disk* disk, int cluster, int value);
+static uint32_t get_cached_fat_entry(struct fat_private_data* private_data, uint32_t cluster);
+static void set_cached_fat_entry(struct fat_private_data* private_data, uint32_t cluster, uint32_t value);
+static int write_fat_sectors(struct disk* disk, int first_cluster, int last_cluster);
+static int allocate_cluster(struct disk* disk, int preferred_cluster);
+static int allocate_cluster_run(struct disk* disk, int preferred_cluster, int wanted_clusters, int* total_allocated_clusters);
+static int get_total_free_clusters_from(struct fat_private_data* private_data, uint32_t cluster, int max_clusters);
+static int find_free_cluster_run(struct fat_private_data* private_data, int wanted_clusters, uint32_t* start_cluster);
+static bool find_free_cluster_run_in_range(struct fat_private_data* private_data, uint32_t from_cluster, uint32_t to_cluster, int wanted_clusters, uint32_t* start_cluster, int* largest_run_length);
+static int free_cluster_chain(struct disk* disk, int cluster);
+static bool is_cluster_used(struct fat_private_data* private_data, uint32_t cluster);
+static void mark_cluster(struct fat_private_data* private_data, uint32_t cluster, bool used);
+static int build_free_cluster_bitmap(struct disk* disk, struct fat_private_data* private_data);
+static uint32_t get_first_fat_sector(struct fat_private_data* private_data);
+static int load_fat_table(struct disk* disk, struct fat_private_data* private_data);
+void free_directory(struct fat_directory* directory);
+struct fat_directory_item* clone_directory_item(struct fat_directory_item* directory_item, int size);
+struct fat_directory* clone_directory(struct fat_directory* directory);
+void free_fat_item(struct fat_item* item);
+
+int fat_read(struct disk* disk, void* descriptor, uint32_t num_of_bytes, uint32_t num_of_blocks, char* out_ptr);
+
+int fat_write(struct disk* disk, void* descriptor, uint32_t num_of_bytes, uint32_t num_of_blocks, const char* in_ptr);
+
+int fat_read_at(struct disk* disk, void* descriptor, uint32_t num_of_bytes, FILE_POSITION position, char* out_ptr);
+
+int fat_seek(void* private_descriptor, FILE_OFFSET offset, FILE_SEEK_MODE seek_mode);
+
+int fat_stat(struct disk* disk, void* private, struct file_stat* stat);
+
+int fat_close(void* private_data);
+static void free_file_descriptor(struct fat_file_descriptor* descriptor);
+
+void* fat_open_directory(struct disk* disk, struct path_part* path);
+int fat_read_directory(struct disk* disk, void* private_data, struct directory_entry* out, uint32_t size);
+int fat_close_directory(void* private_data);
+
+struct filesystem fat16 = {
+    .resolve = resolve_fat16_filesystem,
+    .open = fat_open,
+    .read = fat_read,
+    .write = fat_write,
+    .read_at = fat_read_at,
+    .seek = fat_seek,
+    .stat = fat_stat,
+    .close = fat_close,
+    .open_directory = fat_open_directory,
+    .read_directory = fat_read_directory,
+    .close_directory = fat_close_directory,
+    .unmount = fat_unmount,
+};
+
+// FAT32 shares every operation with FAT16, only on-disk layout differs
+struct filesystem fat32 = {
+    .resolve = resolve_fat32_filesystem,
+    .open = fat_open,
+    .read = fat_read,
+    .write = fat_write,
+    .read_at = fat_read_at,
+    .seek = fat_seek,
+    .stat = fat_stat,
+    .close = fat_close,
+    .open_directory = fat_open_directory,
+    .read_directory = fat_read_directory,
+    .close_directory = fat_close_directory,
+    .unmount = fat_unmount,
+};
+
+struct filesystem* initialize_fat16_filesystem() {
+    strcpy(fat16.name, "FAT16");
+    return &fat16;
+}
+
+struct filesystem* initialize_fat32_filesystem() {
+    strcpy(fat32.name, "FAT32");
+    return &fat32;
+}
+
+int resolve_fat16_filesystem(struct disk* disk) {
+    return resolve_fat_filesystem(disk, &fat16, FAT_TYPE_FAT16);
+}
+
+int resolve_fat32_filesystem(struct disk* disk) {
+    return resolve_fat_filesystem(disk, &fat32, FAT_TYPE_FAT32);
+}
+
+static int resolve_fat_filesystem(struct disk* disk, struct filesystem* filesystem, FAT_TYPE fat_type) {
+    int result = 0;
+    struct fat_private_data* private_data = kzalloc(sizeof(struct fat_private_data));
+    initialize_fat_private_data(disk, private_data);
+
+    disk->filesystem_private_data = private_data;
+    disk->filesystem = filesystem;
+
+    struct disk_stream* stream = create_disk_stream(disk->id);
+    if (!stream) {
+        result = -NO_FREE_MEM_ERROR;
+        goto out;
+    }
+
+    if (read_from_disk_stream(stream, &private_data->header, sizeof(private_data->header)) != ALL_OK) {
+        result = -IO_ERROR;
+        goto out;
+    }
+
+    result = initialize_fat_layout(disk, private_data, fat_type);
+    if (result < 0) {
+        goto out;
+    }
+
+    result = load_fat_table(disk, private_data);
+    if (result < 0) {
+        goto out;
+    }
+
+    result = build_free_cluster_bitmap(disk, private_data);
+    if (result < 0) {
+        goto out;
+    }
+
+    result = read_fs_info(disk, private_data);
+    if (result < 0) {
+        goto out;
+    }
+
+    // FAT32 root directory is a cluster chain, so it's loaded after FAT
+    if (get_fat_root_directory(disk, private_data, &private_data->root_directory) != ALL_OK) {
+        result = -IO_ERROR;
+        goto out;
+    }
+
+out:
+    if (stream) {
+        close_disk_stream(stream);
+    }
+
+    // every other filesystem is tried on this disk after this one, don't leak for each
+    if (result < 0) {
+        free_fat_private_data(disk);
+    }
+    return result;
+}
+
+// Release everything resolve loaded. Also used when resolve fails half way, so every part may be missing
+static void free_fat_private_data(struct disk* disk) {
+    struct fat_private_data* private_data = disk->filesystem_private_data;
+
+    if (private_data->fat_table) {
+        kfree(private_data->fat_table);
+    }
+    if (private_data->free_cluster_bitmap) {
+        kfree(private_data->free_cluster_bitmap);
+    }
+
+    struct disk_stream* streams[] = { private_data->cluster_read_stream, private_data->fat_read_stream, private_data->directory_stream, private_data->write_stream };
+    for (int i = 0; i < sizeof(streams) / sizeof(streams[0]); i++) {
+        if (streams[i]) {
+            close_disk_stream(streams[i]);
+        }
+    }
+
+    for (int i = 0; i < FAT_DENTRY_CACHE_SIZE; i++) {
+        if (private_data->dentry_cache[i].in_use) {
+            release_dentry(&private_data->dentry_cache[i]);
+        }
+    }
+    free_directory_contents(&private_data->root_directory);
+
+    kfree(private_data);
+    disk->filesystem_private_data = 0;
+}
+
+// VFS makes sure no file or directory is still open
+int fat_unmount(struct disk* disk) {
+    int result = write_fs_info(disk);
+    free_fat_private_data(disk);
+    return result;
+}
+
+// FAT32 header is told apart by its layout: no fixed root directory, and FAT size in 32 bit field.
+// Extended header signature lives at a different offset for each type
+static int initialize_fat_layout(struct disk* disk, struct fat_private_data* private_data, FAT_TYPE fat_type) {
+    struct primary_fat_header* primary_header = &private_data->header.primary_fat_header;
+    bool has_fat32_layout = primary_header->sectors_per_fat == 0 && primary_header->root_dir_entries == 0;
+
+    if (fat_type == FAT_TYPE_FAT32) {
+        struct fat32_extended_header* fat32_header = &private_data->header.shared.fat32_extended_header;
+        if (!has_fat32_layout || fat32_header->extended_header.signature != FAT32_SIGNATURE) {
+            return -INVALID_FS_SIGNATURE_ERROR;
+        }
+
+        private_data->sectors_per_fat = fat32_header->sectors_per_fat;
+        private_data->root_directory_cluster = fat32_header->root_directory_cluster;
+        private_data->fs_info_sector = fat32_header->fs_info_sector;
+        private_data->fat_entry_size = FAT32_FAT_ENTRY_SIZE;
+        private_data->reserved_cluster_start = FAT32_RESERVED_CLUSTER_START;
+        private_data->bad_cluster = FAT32_BAD_SECTOR;
+        private_data->end_of_chain = FAT32_END_OF_CHAIN;
+    } else {
+        if (has_fat32_layout || private_data->header.shared.extended_header.signature != FAT16_SIGNATURE) {
+            return -INVALID_FS_SIGNATURE_ERROR;
+        }
+
+        private_data->sectors_per_fat = primary_header->sectors_per_fat;
+        private_data->root_directory_cluster = FAT_ROOT_DIRECTORY_CLUSTER;
+        private_data->fat_entry_size = FAT16_FAT_ENTRY_SIZE;
+        private_data->reserved_cluster_start = FAT16_RESERVED_CLUSTER_START;
+        private_data->bad_cluster = FAT16_BAD_SECTOR;
+        private_data->end_of_chain = FAT16_END_OF_CHAIN;
+    }
+
+    if (primary_header->sectors_per_cluster == 0 || private_data->sectors_per_fat == 0) {
+        return -INVALID_FS_SIGNATURE_ERROR;
+    }
+
+    // Larger volume would overflow byte positions past 2GiB and silently read or write wrong sectors.
+    // Compared in sectors so nothing here overflows, and no 64 bit division is needed(no libgcc)
+    uint32_t total_sectors = primary_header->num_of_sectors != 0 ? primary_header->num_of_sectors : primary_header->sectors_big;
+    if (total_sectors > FAT_MAX_VOLUME_BYTES / disk->sector_size) {
+        return -UNIMPLEMENTED_ERROR;
+    }
+
+    // root_dir_entries is 0 for FAT32, data area starts right after FATs
+    int root_directory_size = primary_header->root_dir_entries * sizeof(struct fat_directory_item);
+    int root_directory_sectors = (root_directory_size + disk->sector_size - 1) / disk->sector_size;
+    private_data->fat_type = fat_type;
+    private_data->first_data_sector = get_first_fat_sector(private_data) + primary_header->fat_copies * private_data->sectors_per_fat + root_directory_sectors;
+
+    return ALL_OK;
+}
+
+// FSInfo only holds hints. Free cluster count is known from cached FAT anyway,
+// next free cluster saves searching through the used beginning of disk on first allocation
+static int read_fs_info(struct disk* disk, struct fat_private_data* private_data) {
+    int result = 0;
+    struct fat32_fs_info fs_info;
+    struct disk_stream* stream = private_data->fat_read_stream;
+
+    if (private_data->fs_info_sector == 0) {
+        goto out;
+    }
+
+    result = set_disk_stream_position(stream, convert_sector_to_absolute_byte(disk, private_data->fs_info_sector));
+    if (result < 0) {
+        goto out;
+    }
+
+    result = read_from_disk_stream(stream, &fs_info, sizeof(fs_info));
+    if (result < 0) {
+        goto out;
+    }
+
+    // not a valid FSInfo sector, never write it back
+    if (fs_info.lead_signature != FAT32_FS_INFO_LEAD_SIGNATURE || fs_info.struct_signature != FAT32_FS_INFO_STRUCT_SIGNATURE || fs_info.trail_signature != FAT32_FS_INFO_TRAIL_SIGNATURE) {
+        private_data->fs_info_sector = 0;
+        goto out;
+    }
+
+    if (fs_info.next_free_cluster >= FAT_FIRST_DATA_CLUSTER && fs_info.next_free_cluster < private_data->total_clusters) {
+        private_data->next_free_cluster_hint = fs_info.next_free_cluster;
+    }
+
+    // stale count is corrected on next write back
+    private_data->is_fs_info_dirty = fs_info.free_cluster_count != private_data->total_free_clusters;
+
+out:
+    return result;
+}
+
+static int write_fs_info(struct disk* disk) {
+    int result = 0;
+    struct fat_private_data* private_data = disk->filesystem_private_data;
+    struct disk_stream* stream = private_data->write_stream;
+
+    if (private_data->fs_info_sector == 0 || !private_data->is_fs_info_dirty) {
+        goto out;
+    }
+
+    // free cluster count and next free cluster are next to each other, write only them
+    uint32_t hints[2] = { private_data->total_free_clusters, private_data->next_free_cluster_hint };
+    int position = convert_sector_to_absolute_byte(disk, private_data->fs_info_sector) + offsetof(struct fat32_fs_info, free_cluster_count);
+    result = set_disk_stream_position(stream, position);
+    if (result < 0) {
+        goto out;
+    }
+
+    result = write_to_disk_stream(stream, hints, sizeof(hints));
+    if (result < 0) {
+        goto out;
+    }
+
+    private_data->is_fs_info_dirty = false;
+
+out:
+    return result;
+}
+
+static void initialize_fat_private_data(struct disk* disk, struct fat_private_data* private_data) {
+    memset(private_data, 0, sizeof(struct fat_private_data));
+    private_data->cluster_read_stream = create_disk_stream(disk->id);
+    private_data->fat_read_stream = create_disk_stream(disk->id);
+    private_data->directory_stream = create_disk_stream(disk->id);
+    private_data->write_stream = create_disk_stream(disk->id);
+}
+
+// FAT16 root directory is a fixed area right after FATs, read it in a single read.
+// FAT32 root directory is a cluster chain like any subdirectory
+int get_fat_root_directory(struct disk* disk, struct fat_private_data* private_data, struct fat_directory* directory) {
+    int result = 0;
+    struct fat_directory_item* root_directory = 0x00;
+
+    if (private_data->root_directory_cluster != FAT_ROOT_DIRECTORY_CLUSTER) {
+        result = read_directory_clusters(disk, private_data->root_directory_cluster, directory);
+        if (result < 0) {
+            goto error_out;
+        }
+        goto out;
+    }
+
+    struct primary_fat_header* primary_header = &private_data->header.primary_fat_header;
+    int root_directory_sector_position = (primary_header->fat_copies * private_data->sectors_per_fat) + primary_header->reserved_sectors;
+    int root_directory_entries = private_data->header.primary_fat_header.root_dir_entries;
+    int root_directory_size = (root_directory_entries * sizeof(struct fat_directory_item));
+    int total_sectors = root_directory_size / disk->sector_size;
+    if (root_directory_size % disk->sector_size) {
+        total_sectors += 1; // load 1 more sector
+    }
+
+    root_directory = kzalloc(root_directory_size);
+
+    if (!root_directory) {
+        result = -NO_FREE_MEM_ERROR;
+        goto error_out;
+    }
+
+    struct disk_stream* stream = private_data->directory_stream;
+    if (set_disk_stream_position(stream, convert_sector_to_absolute_byte(disk, root_directory_sector_position)) != ALL_OK) {
+        result = -IO_ERROR;
+        goto error_out;
+    }
+
+    if (read_from_disk_stream(stream, root_directory, root_directory_size) != ALL_OK) {
+        result = -IO_ERROR;
+        goto error_out;
+    }
+
+    directory->start_sector_position = root_directory_sector_position;
+    directory->end_sector_position = root_directory_sector_position + total_sectors;
+
+    // buffer is owned by directory from here
+    result = index_directory_items(directory, root_directory, root_directory_entries);
+    root_directory = 0;
+    if (result < 0) {
+        goto error_out;
+    }
+out:
+    return result;
+
+error_out:
+    if (root_directory) {
+        kfree(root_directory);
+    }
+    free_directory_contents(directory);
+    directory->item = 0;
+    directory->name_index = 0;
+    directory->item_slots = 0;
+    directory->long_names = 0;
+    directory->long_name_offsets = 0;
+
+    return result;
+}
+
+int convert_sector_to_absolute_byte(struct disk* disk, int sector) {
+    return sector * disk->sector_size;
+}
+
+void* fat_open(struct disk* disk, struct path_part* path, FILE_MODE mode) {
+    struct fat_file_descriptor* descriptor = 0;
+    int error_code = 0;
+
+    descriptor = kzalloc(sizeof(struct fat_file_descriptor));
+    if (!descriptor) {
+        error_code = -NO_FREE_MEM_ERROR;
+        goto error_out;
+    }
+
+    // beginning of a file
+    descriptor->position = 0;
+    descriptor->mode = mode;
+    descriptor->disk = disk;
+
+    if (mode != FILE_MODE_READ) {
+        error_code = open_file_for_writing(disk, descriptor, path, mode);
+        if (error_code < 0) {
+            goto error_out;
+        }
+
+        return descriptor;
+    }
+
+    // find file in given path
+    descriptor->item = get_directory_entry(disk, path);
+    if (!descriptor->item) {
+        error_code = -IO_ERROR;
+        goto error_out;
+    }
+
+    return descriptor;
+
+error_out:
+    if (descriptor) {
+        kfree(descriptor);
+    }
+    return ERROR(error_code);
+}
+
+// Writing needs location of the directory item, so it can be updated once file grows.
+// File is created if it doesn't exist yet. "w" truncates existing file, "a" writes from end of file
+static int open_file_for_writing(struct disk* disk, struct fat_file_descriptor* descriptor, struct path_part* path, FILE_MODE mode) {
+    int result = 0;
+    uint32_t parent_cluster = FAT_ROOT_DIRECTORY_CLUSTER;
+    struct path_part* last_part = 0;
+    struct fat_directory_item item;
+    int item_slot = 0;
+
+    struct fat_directory* parent_directory = get_parent_directory(disk, path, &parent_cluster, &last_part);
+    if (!parent_directory) {
+        result = -IO_ERROR;
+        goto out;
+    }
+
+    struct fat_dentry* dentry = get_dentry(disk, parent_directory, parent_cluster, last_part->part);
+    if (!dentry) {
+        result = -INVALID_ARG_ERROR;
+        goto out;
+    }
+
+    if (dentry->negative) {
+        // creating file drops cached contents of parent directory, dentry can't be used after this
+        result = create_file(disk, parent_cluster, last_part->part, &item);
+        if (result < 0) {
+            goto out;
+        }
+        item_slot = result;
+    } else {
+        if (dentry->item.attribute & (FAT_FILE_SUBDIRECTORY | FAT_FILE_READ_ONLY | FAT_FILE_VOLUME_LABEL)) {
+            result = -READ_ONLY_ERROR;
+            goto out;
+        }
+        memcpy(&item, &dentry->item, sizeof(struct fat_directory_item));
+        item_slot = dentry->item_slot;
+    }
+
+    descriptor->item = kzalloc(sizeof(struct fat_item));
+    if (!descriptor->item) {
+        result = -NO_FREE_MEM_ERROR;
+        goto out;
+    }
+
+    descriptor->item->item_type = FAT_ITEM_TYPE_FILE;
+    descriptor->item->item = clone_directory_item(&item, sizeof(struct fat_directory_item));
+    if (!descriptor->item->item) {
+        result = -NO_FREE_MEM_ERROR;
+        goto out;
+    }
+
+    descriptor->parent_cluster = parent_cluster;
+    descriptor->item_slot = item_slot;
+
+    if (mode == FILE_MODE_WRITE && (get_first_cluster(&item) != 0 || item.filesize != 0)) {
+        result = truncate_file(disk, descriptor);
+        if (result < 0) {
+            goto out;
+        }
+    }
+
+    if (mode == FILE_MODE_APPEND) {
+        descriptor->position = item.filesize;
+    }
+
+    result = ALL_OK;
+
+out:
+    if (result < 0 && descriptor->item) {
+        free_fat_item(descriptor->item);
+        descriptor->item = 0;
+    }
+    return result;
+}
+
+// Put a new empty file item into a free slot of parent directory. Return index of the slot
+static int create_file(struct disk* disk, uint32_t parent_cluster, const char* name, struct fat_directory_item* item) {
+    int result = 0;
+    uint8_t short_name[FAT_SHORT_NAME_LENGTH];
+
+    // only 8.3 names can be created, "." and ".." always exist
+    if (name[0] == '.' || !convert_name_to_short_name(name, short_name)) {
+        result = -INVALID_ARG_ERROR;
+        goto out;
+    }
+
+    int item_slot = find_free_directory_slot(disk, parent_cluster);
+    if (item_slot < 0) {
+        result = item_slot;
+        goto out;
+    }
+
+    memset(item, 0, sizeof(struct fat_directory_item));
+    memcpy(item->filename, short_name, sizeof(item->filename));
+    memcpy(item->extension, short_name + sizeof(item->filename), sizeof(item->extension));
+    item->attribute = FAT_FILE_ARCHIVED;
+
+    result = write_directory_item(disk, parent_cluster, item_slot, item);
+    if (result < 0) {
+        goto out;
+    }
+
+    // cached contents of parent directory, and the negative dentry of the name are out of date now
+    result = invalidate_directory_cache(disk, parent_cluster);
+    if (result < 0) {
+        goto out;
+    }
+
+    result = item_slot;
+
+out:
+    return result;
+}
+
+// Directory item is cleared before the chain is freed,
+// so crash in between only leaks clusters instead of leaving item pointing to free clusters
+static int truncate_file(struct disk* disk, struct fat_file_descriptor* descriptor) {
+    int result = 0;
+    struct fat_directory_item* item = descriptor->item->item;
+    int first_cluster = get_first_cluster(item);
+
+    set_first_cluster(item, 0);
+    item->filesize = 0;
+    descriptor->cursor.cluster_index = 0;
+    descriptor->cursor.cluster = 0;
+
+    result = write_directory_item(disk, descriptor->parent_cluster, descriptor->item_slot, item);
+    if (result < 0) {
+        goto out;
+    }
+
+    if (first_cluster != 0) {
+        result = free_cluster_chain(disk, first_cluster);
+    }
+
+out:
+    return result;
+}
+
+// Make cluster chain long enough to hold given size. Growing file most likely keeps growing,
+// so FAT_PREALLOCATE_CLUSTERS more clusters are reserved on the way(released on close).
+// New clusters are allocated as continuous runs, starting right after the last cluster whenever possible,
+// so file stays continuous and can be read as a single extent
+static int extend_file(struct disk* disk, struct fat_file_descriptor* descriptor, uint32_t size) {
+    int result = 0;
+    struct fat_private_data* private_data = disk->filesystem_private_data;
+    int size_of_cluster_in_bytes = private_data->header.primary_fat_header.sectors_per_cluster * disk->sector_size;
+    struct fat_directory_item* item = descriptor->item->item;
+    int total_clusters_needed = (size + size_of_cluster_in_bytes - 1) / size_of_cluster_in_bytes;
+    int total_clusters = 0;
+    int last_cluster = 0;
+
+    int first_cluster = get_first_cluster(item);
+    if (first_cluster != 0) {
+        // count from cached cursor, so appending never walks the whole chain again
+        int walk_from_cluster = first_cluster;
+        int walk_from_index = 0;
+        if (descriptor->cursor.cluster != 0) {
+            walk_from_cluster = descriptor->cursor.cluster;
+            walk_from_index = descriptor->cursor.cluster_index;
+        }
+
+        result = get_total_clusters_in_chain(disk, walk_from_cluster, &last_cluster);
+        if (result < 0) {
+            goto out;
+        }
+        total_clusters = walk_from_index + result;
+    }
+
+    result = ALL_OK;
+    if (total_clusters >= total_clusters_needed) {
+        goto out;
+    }
+
+    int total_clusters_wanted = total_clusters_needed + FAT_PREALLOCATE_CLUSTERS;
+    while (total_clusters < total_clusters_wanted) {
+        int total_allocated_clusters = 0;
+        int new_cluster = allocate_cluster_run(disk, last_cluster != 0 ? last_cluster + 1 : 0, total_clusters_wanted - total_clusters, &total_allocated_clusters);
+        if (new_cluster < 0) {
+            // preallocation is best effort, only clusters really needed matter
+            result = total_clusters >= total_clusters_needed ? ALL_OK : new_cluster;
+            goto out;
+        }
+
+        if (last_cluster == 0) {
+            set_first_cluster(item, new_cluster);
+        } else {
+            result = set_fat_entry(disk, last_cluster, new_cluster);
+            if (result < 0) {
+                // run isn't part of the chain, nothing else would ever free it
+                free_cluster_chain(disk, new_cluster);
+                goto out;
+            }
+        }
+
+        // chain now reaches past file size. Flag it before anything else can fail,
+        // so close trims it back even if a later run can't be allocated or linked
+        descriptor->has_preallocated_clusters = true;
+
+        last_cluster = new_cluster + total_allocated_clusters - 1;
+        total_clusters += total_allocated_clusters;
+    }
+
+out:
+    return result;
+}
+
+// Release clusters beyond file size, which were preallocated by extend_file
+static int release_preallocated_clusters(struct disk* disk, struct fat_file_descriptor* descriptor) {
+    int result = 0;
+    struct fat_private_data* private_data = disk->filesystem_private_data;
+    int size_of_cluster_in_bytes = private_data->header.primary_fat_header.sectors_per_cluster * disk->sector_size;
+    struct fat_directory_item* item = descriptor->item->item;
+    int total_clusters_needed = (item->filesize + size_of_cluster_in_bytes - 1) / size_of_cluster_in_bytes;
+    int first_cluster = get_first_cluster(item);
+
+    if (first_cluster == 0) {
+        goto out;
+    }
+
+    // nothing written at all, the whole chain goes away
+    if (total_clusters_needed == 0) {
+        result = truncate_file(disk, descriptor);
+        goto out;
+    }
+
+    int last_cluster = get_cluster_via_cursor(disk, &descriptor->cursor, first_cluster, total_clusters_needed - 1);
+    if (last_cluster < 0) {
+        result = last_cluster;
+        goto out;
+    }
+
+    int next_cluster = get_fat_entry(disk, last_cluster);
+    if (next_cluster < 0 || next_cluster >= private_data->end_of_chain) {
+        result = next_cluster < 0 ? next_cluster : ALL_OK;
+        goto out;
+    }
+
+    result = set_fat_entry(disk, last_cluster, private_data->end_of_chain);
+    if (result < 0) {
+        goto out;
+    }
+
+    result = free_cluster_chain(disk, next_cluster);
+
+out:
+    return result;
+}
+
+// Resolve path component by component through dentry cache.
+// Only cache miss searches directory, and subdirectory contents are loaded once then kept in the cache
+struct fat_item* get_directory_entry(struct disk* disk, struct path_part* path) {
+    uint32_t parent_cluster = FAT_ROOT_DIRECTORY_CLUSTER;
+    struct path_part* last_part = 0;
+
+    struct fat_directory* parent_directory = get_parent_directory(disk, path, &parent_cluster, &last_part);
+    if (!parent_directory) {
+        return 0;
+    }
+
+    struct fat_dentry* dentry = get_dentry(disk, parent_directory, parent_cluster, last_part->part);
+    if (!dentry || dentry->negative) {
+        return 0;
+    }
+
+    return new_fat_item_for_dentry(disk, dentry);
+}
+
+// Walk through every component except the last one, return directory which should contain the last component
+static struct fat_directory* get_parent_directory(struct disk* disk, struct path_part* path, uint32_t* parent_cluster, struct path_part** last_part) {
+    struct fat_private_data* private_data = disk->filesystem_private_data;
+    struct fat_directory* current_directory = &private_data->root_directory;
+    uint32_t current_cluster = FAT_ROOT_DIRECTORY_CLUSTER;
+    struct path_part* current_part = path;
+
+    while (current_part->next) {
+        struct fat_dentry* dentry = get_dentry(disk, current_directory, current_cluster, current_part->part);
+        if (!dentry || dentry->negative) {
+            return 0;
+        }
+
+        // only directory can have children
+        if (!(dentry->item.attribute & FAT_FILE_SUBDIRECTORY)) {
+            return 0;
+        }
+
+        current_directory = get_dentry_directory(disk, dentry);
+        if (!current_directory) {
+            return 0;
+        }
+
+        current_cluster = get_first_cluster(&dentry->item);
+        current_part = current_part->next;
+    }
+
+    *parent_cluster = current_cluster;
+    *last_part = current_part;
+    return current_directory;
+}
+
+// FAT stores 8.3 name as 11 bytes: 8 bytes filename + 3 bytes extension, both padded with spaces.
+// Convert "name.ext" into that form(upper case), so it can be compared with directory items byte by byte.
+// Return false if the name can never be a 8.3 name
+static bool convert_name_to_short_name(const char* name, uint8_t* short_name) {
+    memset(short_name, ' ', FAT_SHORT_NAME_LENGTH);
+
+    // "." and ".." are stored as is
+    if (strcmp(name, ".", 2) == 0 || strcmp(name, "..", 3) == 0) {
+        memcpy(short_name, (void*) name, strlen(name));
+        return true;
+    }
+
+    int i = 0;
+    for (; name[i] != 0x00 && name[i] != '.'; i++) {
+        if (i >= 8) {
+            return false;
+        }
+        short_name[i] = toupper(name[i]);
+    }
+
+    if (i == 0) {
+        return false;
+    }
+
+    if (name[i] == '.') {
+        const char* extension = &name[i + 1];
+        for (int j = 0; extension[j] != 0x00; j++) {
+            if (j >= 3 || extension[j] == '.') {
+                return false;
+            }
+            short_name[8 + j] = toupper(extension[j]);
+        }
+    }
+
+    return true;
+}
+
+static void get_short_name_of_item(struct fat_directory_item* item, uint8_t* short_name) {
+    for (int i = 0; i < FAT_SHORT_NAME_LENGTH; i++) {
+        short_name[i] = toupper(i < 8 ? item->filename[i] : item->extension[i - 8]);
+    }
+}
+
+// FNV-1a
+static uint32_t hash_short_name(uint8_t* short_name) {
+    uint32_t hash = 2166136261u;
+    for (int i = 0; i < FAT_SHORT_NAME_LENGTH; i++) {
+        hash ^= short_name[i];
+        hash *= 16777619u;
+    }
+
+    return hash;
+}
+
+// 13 UCS-2 characters split into 3 parts. Name ends with 0x0000 and padded with 0xFFFF.
+// Kernel only prints ASCII, other characters become '?'
+static void copy_long_name_characters(struct fat_long_name_item* long_name_item, char* out) {
+    uint16_t characters[FAT_LONG_NAME_CHARACTERS_PER_ITEM];
+    memcpy(characters, long_name_item->name_part_1, sizeof(long_name_item->name_part_1));
+    memcpy(characters + 5, long_name_item->name_part_2, sizeof(long_name_item->name_part_2));
+    memcpy(characters + 11, long_name_item->name_part_3, sizeof(long_name_item->name_part_3));
+
+    for (int i = 0; i < FAT_LONG_NAME_CHARACTERS_PER_ITEM; i++) {
+        uint16_t character = characters[i];
+        if (character == 0x0000 || character == 0xFFFF) {
+            out[i] = 0x00;
+        } else if (character > 0x7F) {
+            out[i] = '?';
+        } else {
+            out[i] = (char) character;
+        }
+    }
+}
+
+// checksum of raw 11 bytes short name, stored in every LFN item of the name
+static uint8_t get_short_name_checksum(struct fat_directory_item* item) {
+    uint8_t checksum = 0;
+    for (int i = 0; i < FAT_SHORT_NAME_LENGTH; i++) {
+        uint8_t character = i < 8 ? item->filename[i] : item->extension[i - 8];
+        checksum = ((checksum & 1) << 7) + (checksum >> 1) + character;
+    }
+
+    return checksum;
+}
+
+// All long names of a directory share one buffer, which doubles when full. Return offset of the name in the buffer
+static int append_long_name(struct fat_directory* directory, int* long_names_capacity, const char* long_name) {
+    int length = strlen(long_name) + 1;
+
+    if (directory->long_names_size + length > *long_names_capacity) {
+        int new_capacity = *long_names_capacity > 0 ? *long_names_capacity : FAT_INITIAL_LONG_NAMES_SIZE;
+        while (directory->long_names_size + length > new_capacity) {
+            new_capacity *= 2;
+        }
+
+        char* new_long_names = kzalloc(new_capacity);
+        if (!new_long_names) {
+            return -NO_FREE_MEM_ERROR;
+        }
+
+        if (directory->long_names) {
+            memcpy(new_long_names, directory->long_names, directory->long_names_size);
+            kfree(directory->long_names);
+        }
+
+        directory->long_names = new_long_names;
+        *long_names_capacity = new_capacity;
+    }
+
+    int offset = directory->long_names_size;
+    memcpy(directory->long_names + offset, (void*) long_name, length);
+    directory->long_names_size += length;
+
+    return offset;
+}
+
+static const char* get_long_name_of_item(struct fat_directory* directory, int item_index) {
+    if (!directory->long_name_offsets || directory->long_name_offsets[item_index] == FAT_NO_LONG_NAME) {
+        return 0;
+    }
+
+    return directory->long_names + directory->long_name_offsets[item_index];
+}
+
+// FNV-1a, case insensitive as long names are matched case insensitively
+static uint32_t hash_long_name(const char* long_name) {
+    uint32_t hash = 2166136261u;
+    for (int i = 0; long_name[i] != 0x00; i++) {
+        hash ^= (uint8_t) toupper(long_name[i]);
+        hash *= 16777619u;
+    }
+
+    return hash;
+}
+
+static void insert_into_name_index(struct fat_directory* directory, uint32_t hash, int item_index) {
+    uint32_t slot = hash & (directory->name_index_size - 1);
+    while (directory->name_index[slot] != FAT_EMPTY_NAME_INDEX) {
+        slot = (slot + 1) & (directory->name_index_size - 1);
+    }
+    directory->name_index[slot] = item_index;
+}
+
+// Single pass over raw items read from disk, no more disk access here:
+// decode long names, drop deleted, LFN and volume label items by compacting the buffer in place,
+// remember on-disk slot of every kept item, and index it by name. Blank item marks end of directory
+static int index_directory_items(struct fat_directory* directory, struct fat_directory_item* items, int total_slots) {
+    int result = 0;
+    char long_name[FAT_MAX_LONG_NAME_ITEMS * FAT_LONG_NAME_CHARACTERS_PER_ITEM + 1];
+    int long_names_capacity = 0;
+    int next_order = -1; // order of the LFN item expected next, 0 once sequence is complete, -1 if no sequence
+    uint8_t checksum = 0;
+
+    directory->item = items;
+    directory->total_num_of_items = 0;
+
+    // kept items never outnumber slots
+    directory->item_slots = kzalloc((total_slots + 1) * sizeof(int));
+    directory->long_name_offsets = kzalloc((total_slots + 1) * sizeof(int));
+    if (!directory->item_slots || !directory->long_name_offsets) {
+        result = -NO_FREE_MEM_ERROR;
+        goto out;
+    }
+
+    result = resize_name_index(directory, FAT_MIN_NAME_INDEX_SIZE);
+    if (result < 0) {
+        goto out;
+    }
+
+    for (int slot = 0; slot < total_slots; slot++) {
+        struct fat_directory_item* item = &items[slot];
+
+        if (item->filename[0] == 0x00) {
+            break;
+        }
+
+        if (item->filename[0] == FAT_DELETED_ITEM) {
+            next_order = -1;
+            continue;
+        }
+
+        // LFN items come right before the short item they belong to, in reverse order:
+        // the first one stored has order N | FAT_LAST_LONG_NAME_ITEM, the one with order 1 is right before the short item
+        if (item->attribute == FAT_FILE_LONG_NAME) {
+            struct fat_long_name_item* long_name_item = (struct fat_long_name_item*) item;
+            int order = long_name_item->order & FAT_LONG_NAME_ORDER_MASK;
+
+            if (long_name_item->order & FAT_LAST_LONG_NAME_ITEM) {
+                memset(long_name, 0, sizeof(long_name));
+                checksum = long_name_item->checksum;
+                next_order = order;
+            }
+
+            if (order == 0 || order > FAT_MAX_LONG_NAME_ITEMS || order != next_order || long_name_item->checksum != checksum) {
+                next_order = -1;
+                continue;
+            }
+
+            copy_long_name_characters(long_name_item, long_name + (order - 1) * FAT_LONG_NAME_CHARACTERS_PER_ITEM);
+            next_order = order - 1;
+            continue;
+        }
+
+        // long name is used only if sequence is complete, and its checksum matches the short name
+        int long_name_offset = FAT_NO_LONG_NAME;
+        if (next_order == 0 && checksum == get_short_name_checksum(item) && long_name[0] != 0x00) {
+            long_name_offset = append_long_name(directory, &long_names_capacity, long_name);
+            if (long_name_offset < 0) {
+                result = long_name_offset;
+                goto out;
+            }
+        }
+        next_order = -1;
+
+        // volume label only names the disk
+        if (item->attribute & FAT_FILE_VOLUME_LABEL) {
+            continue;
+        }
+
+        // slots before this one are consumed already, so the item can be moved forward safely
+        int item_index = directory->total_num_of_items;
+        if (item_index != slot) {
+            memcpy(&items[item_index], item, sizeof(struct fat_directory_item));
+        }
+        directory->item_slots[item_index] = slot;
+        directory->long_name_offsets[item_index] = long_name_offset;
+        directory->total_num_of_items++;
+
+        result = add_item_to_name_index(directory, item_index);
+        if (result < 0) {
+            goto out;
+        }
+    }
+
+out:
+    return result;
+}
+
+// Open addressing hash table storing item indexes, keyed by short name, and also long name if the item has one.
+// Table size is power of 2, and doubles once items could take more than half of it(2 keys per item at most),
+// so probing sequence stays short
+static int add_item_to_name_index(struct fat_directory* directory, int item_index) {
+    if (directory->total_num_of_items * 4 > directory->name_index_size) {
+        // every item including the new one is inserted again
+        return resize_name_index(directory, directory->name_index_size * 2);
+    }
+
+    insert_item_into_name_index(directory, item_index);
+    return ALL_OK;
+}
+
+static int resize_name_index(struct fat_directory* directory, int index_size) {
+    int* name_index = kzalloc(index_size * sizeof(int));
+    if (!name_index) {
+        return -NO_FREE_MEM_ERROR;
+    }
+
+    for (int i = 0; i < index_size; i++) {
+        name_index[i] = FAT_EMPTY_NAME_INDEX;
+    }
+
+    if (directory->name_index) {
+        kfree(directory->name_index);
+    }
+    directory->name_index = name_index;
+    directory->name_index_size = index_size;
+
+    for (int i = 0; i < directory->total_num_of_items; i++) {
+        insert_item_into_name_index(directory, i);
+    }
+
+    return ALL_OK;
+}
+
+static void insert_item_into_name_index(struct fat_directory* directory, int item_index) {
+    uint8_t short_name[FAT_SHORT_NAME_LENGTH];
+    get_short_name_of_item(&directory->item[item_index], short_name);
+    insert_into_name_index(directory, hash_short_name(short_name), item_index);
+
+    const char* long_name = get_long_name_of_item(directory, item_index);
+    if (long_name) {
+        insert_into_name_index(directory, hash_long_name(long_name), item_index);
+    }
+}
+
+// Name can be either long name or 8.3 name of the item, like what Windows and Linux accept
+struct fat_directory_item* find_item_in_directory(struct fat_directory* directory, const char* target_filename) {
+    if (!directory->name_index) {
+        return 0;
+    }
+
+    struct fat_directory_item* item = find_item_by_long_name(directory, target_filename);
+    if (item) {
+        return item;
+    }
+
+    return find_item_by_short_name(directory, target_filename);
+}
+
+static struct fat_directory_item* find_item_by_long_name(struct fat_directory* directory, const char* long_name) {
+    uint32_t slot = hash_long_name(long_name) & (directory->name_index_size - 1);
+    while (directory->name_index[slot] != FAT_EMPTY_NAME_INDEX) {
+        int item_index = directory->name_index[slot];
+        const char* item_long_name = get_long_name_of_item(directory, item_index);
+        if (item_long_name && strcmp_case_insensitive(item_long_name, long_name, FAT_DENTRY_NAME_LENGTH) == 0) {
+            return &directory->item[item_index];
+        }
+        slot = (slot + 1) & (directory->name_index_size - 1);
+    }
+
+    return 0;
+}
+
+static struct fat_directory_item* find_item_by_short_name(struct fat_directory* directory, const char* target_filename) {
+    uint8_t target_short_name[FAT_SHORT_NAME_LENGTH];
+    uint8_t short_name[FAT_SHORT_NAME_LENGTH];
+
+    if (!convert_name_to_short_name(target_filename, target_short_name)) {
+        return 0;
+    }
+
+    uint32_t slot = hash_short_name(target_short_name) & (directory->name_index_size - 1);
+    while (directory->name_index[slot] != FAT_EMPTY_NAME_INDEX) {
+        struct fat_directory_item* item = &directory->item[directory->name_index[slot]];
+        get_short_name_of_item(item, short_name);
+        if (memcmp(short_name, target_short_name, FAT_SHORT_NAME_LENGTH) == 0) {
+            return item;
+        }
+        slot = (slot + 1) & (directory->name_index_size - 1);
+    }
+
+    return 0;
+}
+
+// Return cached dentry of the name under parent directory. On cache miss, search the parent directory
+// then cache the result. Names not found are cached as negative entries too
+static struct fat_dentry* get_dentry(struct disk* disk, struct fat_directory* parent_directory, uint32_t parent_cluster, const char* name) {
+    struct fat_private_data* private_data = disk->filesystem_private_data;
+    struct fat_dentry* dentry = find_dentry(private_data, parent_cluster, name);
+    if (dentry) {
+        dentry->last_used = ++private_data->dentry_cache_tick;
+        return dentry;
+    }
+
+    if (strlen(name) >= FAT_DENTRY_NAME_LENGTH) {
+        return 0;
+    }
+
+    struct fat_directory_item* item = find_item_in_directory(parent_directory, name);
+
+    dentry = allocate_dentry(private_data);
+    dentry->parent_cluster = parent_cluster;
+    strcpy_max_length(dentry->name, name, sizeof(dentry->name));
+    dentry->negative = item == 0;
+    if (item) {
+        memcpy(&dentry->item, item, sizeof(struct fat_directory_item));
+        dentry->item_slot = parent_directory->item_slots[item - parent_directory->item];
+    }
+
+    return dentry;
+}
+
+static struct fat_dentry* find_dentry(struct fat_private_data* private_data, uint32_t parent_cluster, const char* name) {
+    for (int i = 0; i < FAT_DENTRY_CACHE_SIZE; i++) {
+        struct fat_dentry* dentry = &private_data->dentry_cache[i];
+        if (dentry->in_use && dentry->parent_cluster == parent_cluster && strcmp_case_insensitive(dentry->name, name, sizeof(dentry->name)) == 0) {
+            return dentry;
+        }
+    }
+
+    return 0;
+}
+
+// take a free slot, or evict least recently used one
+static struct fat_dentry* allocate_dentry(struct fat_private_data* private_data) {
+    struct fat_dentry* victim = &private_data->dentry_cache[0];
+
+    for (int i = 0; i < FAT_DENTRY_CACHE_SIZE; i++) {
+        struct fat_dentry* dentry = &private_data->dentry_cache[i];
+        if (!dentry->in_use) {
+            victim = dentry;
+            break;
+        }
+
+        if (dentry->last_used < victim->last_used) {
+            victim = dentry;
+        }
+    }
+
+    release_dentry(victim);
+    victim->in_use = true;
+    victim->last_used = ++private_data->dentry_cache_tick;
+    return victim;
+}
+
+static void release_dentry(struct fat_dentry* dentry) {
+    if (dentry->directory) {
+        free_directory(dentry->directory);
+    }
+
+    memset(dentry, 0, sizeof(struct fat_dentry));
+}
+
+// contents of subdirectory is loaded on first access, then kept until dentry evicted
+static struct fat_directory* get_dentry_directory(struct disk* disk, struct fat_dentry* dentry) {
+    if (!dentry->directory) {
+        dentry->directory = load_fat_directory(disk, &dentry->item);
+    }
+
+    return dentry->directory;
+}
+
+// Drop everything cached about the directory: names looked up under it and its loaded contents.
+// Root directory is always kept loaded, so it's reloaded instead
+static int invalidate_directory_cache(struct disk* disk, uint32_t directory_cluster) {
+    struct fat_private_data* private_data = disk->filesystem_private_data;
+
+    for (int i = 0; i < FAT_DENTRY_CACHE_SIZE; i++) {
+        struct fat_dentry* dentry = &private_data->dentry_cache[i];
+        if (!dentry->in_use) {
+            continue;
+        }
+
+        if (dentry->parent_cluster == directory_cluster) {
+            release_dentry(dentry);
+            continue;
+        }
+
+        if (dentry->directory && get_first_cluster(&dentry->item) == directory_cluster) {
+            free_directory(dentry->directory);
+            dentry->directory = 0;
+        }
+    }
+
+    if (directory_cluster != FAT_ROOT_DIRECTORY_CLUSTER) {
+        return ALL_OK;
+    }
+
+    struct fat_directory* root_directory = &private_data->root_directory;
+    free_directory_contents(root_directory);
+    memset(root_directory, 0, sizeof(struct fat_directory));
+
+    return get_fat_root_directory(disk, private_data, root_directory);
+}
+
+// Keep cached copies in sync after an item is rewritten in place(name unchanged), so later lookups see new size and first cluster
+static void update_cached_directory_item(struct disk* disk, uint32_t directory_cluster, int item_slot, struct fat_directory_item* item) {
+    struct fat_private_data* private_data = disk->filesystem_private_data;
+    struct fat_directory* directory = 0;
+
+    if (directory_cluster == FAT_ROOT_DIRECTORY_CLUSTER) {
+        directory = &private_data->root_directory;
+    }
+
+    for (int i = 0; i < FAT_DENTRY_CACHE_SIZE; i++) {
+        struct fat_dentry* dentry = &private_data->dentry_cache[i];
+        if (!dentry->in_use || dentry->negative) {
+            continue;
+        }
+
+        if (dentry->parent_cluster == directory_cluster && dentry->item_slot == item_slot) {
+            memcpy(&dentry->item, item, sizeof(struct fat_directory_item));
+        }
+
+        if (dentry->directory && get_first_cluster(&dentry->item) == directory_cluster) {
+            directory = dentry->directory;
+        }
+    }
+
+    if (!directory || !directory->item) {
+        return;
+    }
+
+    for (int i = 0; i < directory->total_num_of_items; i++) {
+        if (directory->item_slots[i] == item_slot) {
+            memcpy(&directory->item[i], item, sizeof(struct fat_directory_item));
+            break;
+        }
+    }
+}
+
+// FAT32 root directory has a cluster chain, while FAT16 one keeps FAT_ROOT_DIRECTORY_CLUSTER
+static uint32_t get_directory_chain_cluster(struct fat_private_data* private_data, uint32_t directory_cluster) {
+    if (directory_cluster == FAT_ROOT_DIRECTORY_CLUSTER) {
+        return private_data->root_directory_cluster;
+    }
+
+    return directory_cluster;
+}
+
+// Byte position of n-th item of the directory on disk.
+// FAT16 root directory is a fixed area right after FATs, other directories are cluster chains like a file
+static int get_directory_item_position(struct disk* disk, uint32_t directory_cluster, int item_slot) {
+    struct fat_private_data* private_data = disk->filesystem_private_data;
+    int size_of_cluster_in_bytes = private_data->header.primary_fat_header.sectors_per_cluster * disk->sector_size;
+    int item_offset = item_slot * sizeof(struct fat_directory_item);
+    uint32_t chain_cluster = get_directory_chain_cluster(private_data, directory_cluster);
+
+    if (chain_cluster == FAT_ROOT_DIRECTORY_CLUSTER) {
+        if (item_slot >= private_data->header.primary_fat_header.root_dir_entries) {
+            return -IO_ERROR;
+        }
+
+        return convert_sector_to_absolute_byte(disk, private_data->root_directory.start_sector_position) + item_offset;
+    }
+
+    int cluster = get_cluster_based_on_offset(disk, chain_cluster, item_offset);
+    if (cluster < 0) {
+        return cluster;
+    }
+
+    return convert_sector_to_absolute_byte(disk, convert_cluster_to_sector(private_data, cluster)) + (item_offset % size_of_cluster_in_bytes);
+}
+
+static int write_directory_item(struct disk* disk, uint32_t directory_cluster, int item_slot, struct fat_directory_item* item) {
+    int result = 0;
+    struct fat_private_data* private_data = disk->filesystem_private_data;
+    struct disk_stream* stream = private_data->write_stream;
+
+    int position = get_directory_item_position(disk, directory_cluster, item_slot);
+    if (position < 0) {
+        result = position;
+        goto out;
+    }
+
+    result = set_disk_stream_position(stream, position);
+    if (result < 0) {
+        goto out;
+    }
+
+    result = write_to_disk_stream(stream, item, sizeof(struct fat_directory_item));
+    if (result < 0) {
+        goto out;
+    }
+
+    update_cached_directory_item(disk, directory_cluster, item_slot, item);
+
+out:
+    return result;
+}
+
+// Deleted item or blank item(end of directory) can be reused.
+// Cached directory drops deleted and LFN items, so free slots can't be told from it.
+// Directory is read one cluster at a time(FAT16 root directory in cluster sized pieces) rather than item by item.
+// Directory chain grows by 1 cluster when it's full, FAT16 root directory has fixed size
+static int find_free_directory_slot(struct disk* disk, uint32_t directory_cluster) {
+    int result = 0;
+    struct fat_private_data* private_data = disk->filesystem_private_data;
+    struct disk_stream* stream = private_data->directory_stream;
+    int size_of_cluster_in_bytes = private_data->header.primary_fat_header.sectors_per_cluster * disk->sector_size;
+    int slots_per_cluster = size_of_cluster_in_bytes / sizeof(struct fat_directory_item);
+    struct fat_directory_item* items = 0;
+    int total_slots = private_data->header.primary_fat_header.root_dir_entries;
+    uint32_t chain_cluster = get_directory_chain_cluster(private_data, directory_cluster);
+
+    if (chain_cluster != FAT_ROOT_DIRECTORY_CLUSTER) {
+        int last_cluster = 0;
+        int total_clusters = get_total_clusters_in_chain(disk, chain_cluster, &last_cluster);
+        if (total_clusters < 0) {
+            result = total_clusters;
+            goto out;
+        }
+        total_slots = total_clusters * slots_per_cluster;
+    }
+
+    items = kzalloc(size_of_cluster_in_bytes);
+    if (!items) {
+        result = -NO_FREE_MEM_ERROR;
+        goto out;
+    }
+
+    for (int first_slot = 0; first_slot < total_slots; first_slot += slots_per_cluster) {
+        int total_chunk_slots = total_slots - first_slot < slots_per_cluster ? total_slots - first_slot : slots_per_cluster;
+        int position = get_directory_item_position(disk, directory_cluster, first_slot);
+        if (position < 0) {
+            result = position;
+            goto out;
+        }
+
+        if (set_disk_stream_position(stream, position) != ALL_OK ||
+            read_from_disk_stream(stream, items, total_chunk_slots * sizeof(struct fat_directory_item)) != ALL_OK) {
+            result = -IO_ERROR;
+            goto out;
+        }
+
+        for (int i = 0; i < total_chunk_slots; i++) {
+            if (items[i].filename[0] == 0x00 || items[i].filename[0] == FAT_DELETED_ITEM) {
+                result = first_slot + i;
+                goto out;
+            }
+        }
+    }
+
+    if (chain_cluster == FAT_ROOT_DIRECTORY_CLUSTER) {
+        result = -NO_FREE_SPACE_ERROR;
+        goto out;
+    }
+
+    result = extend_directory(disk, chain_cluster);
+    if (result < 0) {
+        goto out;
+    }
+
+    // first slot of the new cluster
+    result = total_slots;
+
+out:
+    if (items) {
+        kfree(items);
+    }
+    return result;
+}
+
+// Append a zeroed cluster to the directory. Every item in it is blank, so directory still ends properly
+static int extend_directory(struct disk* disk, uint32_t directory_cluster) {
+    int result = 0;
+    struct fat_private_data* private_data = disk->filesystem_private_data;
+    struct disk_stream* stream = private_data->write_stream;
+    int size_of_cluster_in_bytes = private_data->header.primary_fat_header.sectors_per_cluster * disk->sector_size;
+    char* zeroed_cluster = 0;
+    int last_cluster = 0;
+    int new_cluster = 0;
+
+    result = get_total_clusters_in_chain(disk, directory_cluster, &last_cluster);
+    if (result < 0) {
+        goto out;
+    }
+
+    new_cluster = allocate_cluster(disk, last_cluster + 1);
+    if (new_cluster < 0) {
+        result = new_cluster;
+        goto out;
+    }
+
+    zeroed_cluster = kzalloc(size_of_cluster_in_bytes);
+    if (!zeroed_cluster) {
+        result = -NO_FREE_MEM_ERROR;
+        goto error_out;
+    }
+
+    result = set_disk_stream_position(stream, convert_sector_to_absolute_byte(disk, convert_cluster_to_sector(private_data, new_cluster)));
+    if (result < 0) {
+        goto error_out;
+    }
+
+    result = write_to_disk_stream(stream, zeroed_cluster, size_of_cluster_in_bytes);
+    if (result < 0) {
+        goto error_out;
+    }
+
+    result = set_fat_entry(disk, last_cluster, new_cluster);
+    if (result < 0) {
+        goto error_out;
+    }
+
+    goto out;
+
+error_out:
+    free_cluster_chain(disk, new_cluster);
+
+out:
+    if (zeroed_cluster) {
+        kfree(zeroed_cluster);
+    }
+    return result;
+}
+
+// get file name includes extension
+void get_full_relative_filename(struct fat_directory_item* item, char* out, int max_len) {
+    memset(out, 0x00, max_len);
+    char *temp_out = out;
+    remove_spaces(&temp_out, (const char*) item->filename, sizeof(item->filename));
+    if (item->extension[0] != 0x00 && item->extension[0] != 0x20) {
+        *temp_out++ = '.';
+        remove_spaces(&temp_out, (const char*) item->extension, sizeof(item->extension));
+    }
+}
+
+// file name will end with space(0x00) if file name length shorter than maximum length,
+// or FAT terminator char(0x20). We need to remove redundant spaces
+void remove_spaces(char** out, const char* in, size_t size) {
+    int i = 0;
+
+    // if filename/extension doesn't end with 0x00 or 0x20, this will be an infinity loop
+    // it happens if filename/extension long enough with no spaces to put 0x00 or 0x20
+    while (*in != 0x00 && *in != 0x20) {
+        **out = *in;
+        *out += 1;
+        in += 1;
+
+        // exceeded input buffer size
+        if (i >= size - 1) {
+            break;
+        }
+        i++;
+    }
+
+    **out = 0x00;
+}
+
+// Opened item is owned by caller, so it never shares memory with dentry cache
+struct fat_item* new_fat_item_for_dentry(struct disk* disk, struct fat_dentry* dentry) {
+    struct fat_item* new_item = kzalloc(sizeof(struct fat_item));
+    if (!new_item) {
+        return 0;
+    }
+
+    if (dentry->item.attribute & FAT_FILE_SUBDIRECTORY) {
+        struct fat_directory* directory = get_dentry_directory(disk, dentry);
+        new_item->directory = directory ? clone_directory(directory) : 0;
+        new_item->item_type = FAT_ITEM_TYPE_DIRECTORY;
+
+        if (!new_item->directory) {
+            kfree(new_item);
+            return 0;
+        }
+
+        return new_item;
+    }
+
+    new_item->item_type = FAT_ITEM_TYPE_FILE;
+    new_item->item = clone_directory_item(&dentry->item, sizeof(struct fat_directory_item));
+
+    return new_item;
+}
+
+struct fat_directory* load_fat_directory(struct disk* disk, struct fat_directory_item* directory_item) {
+    int result = 0;
+
+    struct fat_directory* directory = 0;
+    if (!(directory_item->attribute & FAT_FILE_SUBDIRECTORY)) {
+        result = -INVALID_ARG_ERROR;
+        goto out;
+    }
+
+    directory = kzalloc(sizeof(struct fat_directory));
+    if (!directory) {
+        result = -NO_FREE_MEM_ERROR;
+        goto out;
+    }
+
+    result = read_directory_clusters(disk, get_first_cluster(directory_item), directory);
+out:
+    if (result != ALL_OK) {
+        free_directory(directory);
+        directory = 0;
+    }
+    return directory;
+}
+
+// Size of directory is known from cached FAT, so whole chain is read at once,
+// continuous clusters as a single extent
+static int read_directory_clusters(struct disk* disk, uint32_t cluster, struct fat_directory* directory) {
+    int result = 0;
+    struct fat_private_data* private_data = disk->filesystem_private_data;
+
+    int last_cluster = 0;
+    int total_clusters = get_total_clusters_in_chain(disk, cluster, &last_cluster);
+    if (total_clusters < 0) {
+        result = total_clusters;
+        goto out;
+    }
+
+    int directory_size = total_clusters * private_data->header.primary_fat_header.sectors_per_cluster * disk->sector_size;
+    struct fat_directory_item* items = kzalloc(directory_size);
+    if (!items) {
+        result = -NO_FREE_MEM_ERROR;
+        goto out;
+    }
+
+    result = read_data_from_cluster(disk, cluster, 0x00, directory_size, items);
+    if (result != ALL_OK) {
+        kfree(items);
+        goto out;
+    }
+
+    result = index_directory_items(directory, items, directory_size / sizeof(struct fat_directory_item));
+out:
+    return result;
+}
+
+static uint32_t get_first_cluster(struct fat_directory_item* directory_item) {
+    return (directory_item->high_16_bits_of_first_cluster << 16) | directory_item->low_16_bits_of_first_cluster;
+}
+
+// high 16 bits are always 0 for FAT16
+static void set_first_cluster(struct fat_directory_item* directory_item, uint32_t cluster) {
+    directory_item->high_16_bits_of_first_cluster = (cluster >> 16) & 0xFFFF;
+    directory_item->low_16_bits_of_first_cluster = cluster & 0xFFFF;
+}
+
+static int convert_cluster_to_sector(struct fat_private_data* private_data, int cluster) {
+    return private_data->first_data_sector + ((cluster - 2) * private_data->header.primary_fat_header.sectors_per_cluster);
+}
+
+static int read_data_from_cluster(struct disk* disk, int starting_cluster, int offset, int total_bytes_to_read, void* out) {
+    struct fat_private_data* private_data = disk->filesystem_private_data;
+    struct disk_stream* stream = private_data->cluster_read_stream;
+    struct fat_cluster_cursor cursor = {};
+    return transfer_data_via_disk_stream(disk, stream, &cursor, starting_cluster, offset, total_bytes_to_read, out, false);
+}
+
+// same as read_data_from_cluster, but resume cluster chain walking from position cached in opened file
+static int read_data_from_file(struct disk* disk, struct fat_file_descriptor* descriptor, FILE_POSITION offset, int total_bytes_to_read, void* out) {
+    struct fat_private_data* private_data = disk->filesystem_private_data;
+    struct disk_stream* stream = private_data->cluster_read_stream;
+    struct fat_directory_item* directory_item = descriptor->item->item;
+    return transfer_data_via_disk_stream(disk, stream, &descriptor->cursor, get_first_cluster(directory_item), offset, total_bytes_to_read, out, false);
+}
+
+// clusters must be allocated already, see extend_file
+static int write_data_to_file(struct disk* disk, struct fat_file_descriptor* descriptor, FILE_POSITION offset, int total_bytes_to_write, const void* in) {
+    struct fat_private_data* private_data = disk->filesystem_private_data;
+    struct disk_stream* stream = private_data->write_stream;
+    struct fat_directory_item* directory_item = descriptor->item->item;
+    return transfer_data_via_disk_stream(disk, stream, &descriptor->cursor, get_first_cluster(directory_item), offset, total_bytes_to_write, (void*) in, true);
+}
+
+// Read or write extent by extent. An extent is a run of physically continuous clusters in the chain,
+// so it can be transferred with a single multi-sector command
+static int transfer_data_via_disk_stream(struct disk* disk, struct disk_stream* stream, struct fat_cluster_cursor* cursor, int cluster, FILE_POSITION offset, int total_bytes, void* buffer, bool write) {
+    int result = 0;
+    struct fat_private_data* private_data = disk->filesystem_private_data;
+    int size_of_cluster_in_bytes = private_data->header.primary_fat_header.sectors_per_cluster * disk->sector_size;
+
+    while (total_bytes > 0) {
+        int cluster_index = offset / size_of_cluster_in_bytes;
+        int cluster_to_transfer = get_cluster_via_cursor(disk, cursor, cluster, cluster_index);
+        if (cluster_to_transfer < 0) {
+            result = cluster_to_transfer;
+            goto out;
+        }
+
+        int offset_from_cluster = offset % size_of_cluster_in_bytes;
+
+        // no need to look further than clusters this transfer covers
+        int max_clusters = (offset_from_cluster + total_bytes + size_of_cluster_in_bytes - 1) / size_of_cluster_in_bytes;
+        int total_clusters = get_total_continuous_clusters(disk, cluster_to_transfer, max_clusters);
+
+        int starting_sector = convert_cluster_to_sector(private_data, cluster_to_transfer);
+        int starting_byte_position = (starting_sector * disk->sector_size) + offset_from_cluster;
+        // only rest of the extent can be transferred a time at most
+        int rest_bytes_in_extent = total_clusters * size_of_cluster_in_bytes - offset_from_cluster;
+        int current_total_bytes = total_bytes > rest_bytes_in_extent ? rest_bytes_in_extent : total_bytes;
+
+        // clusters in extent are continuous, so the last one can be cached directly
+        cursor->cluster_index = cluster_index + total_clusters - 1;
+        cursor->cluster = cluster_to_transfer + total_clusters - 1;
+
+        result = set_disk_stream_position(stream, starting_byte_position);
+        if (result != ALL_OK) {
+            goto out;
+        }
+
+        if (write) {
+            result = write_to_disk_stream(stream, buffer, current_total_bytes);
+        } else {
+            result = read_from_disk_stream(stream, buffer, current_total_bytes);
+        }
+        if (result != ALL_OK) {
+            goto out;
+        }
+
+        total_bytes -= current_total_bytes;
+        offset += current_total_bytes;
+        buffer += current_total_bytes;
+    }
+out:
+    return result;
+}
+
+// count how many clusters starting from given one are physically next to each other in the chain
+static int get_total_continuous_clusters(struct disk* disk, int cluster, int max_clusters) {
+    int total_clusters = 1;
+
+    while (total_clusters < max_clusters) {
+        int next_cluster = get_fat_entry(disk, cluster);
+        if (next_cluster != cluster + 1) {
+            break;
+        }
+
+        cluster = next_cluster;
+        total_clusters++;
+    }
+
+    return total_clusters;
+}
+
+// Find the n-th(cluster_index) cluster of a chain.
+// Walk from cached (cluster index, cluster) pair if it isn't behind the target, otherwise from starting cluster.
+// Sequential read and forward seek never rewalk the chain
+static int get_cluster_via_cursor(struct disk* disk, struct fat_cluster_cursor* cursor, int starting_cluster, int cluster_index) {
+    struct fat_private_data* private_data = disk->filesystem_private_data;
+    int size_of_cluster_in_bytes = private_data->header.primary_fat_header.sectors_per_cluster * disk->sector_size;
+    int walk_from_cluster = starting_cluster;
+    int walk_from_index = 0;
+
+    if (cursor->cluster != 0 && cursor->cluster_index <= cluster_index) {
+        walk_from_cluster = cursor->cluster;
+        walk_from_index = cursor->cluster_index;
+    }
+
+    int result = get_cluster_based_on_offset(disk, walk_from_cluster, (cluster_index - walk_from_index) * size_of_cluster_in_bytes);
+    if (result < 0) {
+        return result;
+    }
+
+    cursor->cluster_index = cluster_index;
+    cursor->cluster = result;
+    return result;
+}
+
+static int get_cluster_based_on_offset(struct disk* disk, int starting_cluster, int offset) {
+    int result = 0;
+    struct fat_private_data* private_data = disk->filesystem_private_data;
+    int size_of_cluster_in_bytes = private_data->header.primary_fat_header.sectors_per_cluster * disk->sector_size;
+    int cluster_to_read = starting_cluster;
+    int rest_num_of_cluster = offset / size_of_cluster_in_bytes;
+    for (int i = 0; i < rest_num_of_cluster; i++) {
+        int entry = get_fat_entry(disk, cluster_to_read);
+        if (entry < 0) {
+            result = entry;
+            goto out;
+        }
+
+        if (entry >= private_data->end_of_chain) {
+            // last entry in file, but offset still points further
+            result = -IO_ERROR;
+            goto out;
+        }
+
+        // bad sector
+        if (entry == private_data->bad_cluster) {
+            result = -IO_ERROR;
+            goto out;
+        }
+
+        // reserved sector
+        if (entry >= private_data->reserved_cluster_start && entry < private_data->bad_cluster) {
+            result = -IO_ERROR;
+            goto out;
+        }
+
+        // unexpected flag, corrupt
+        if (entry == FAT_UNUSED) {
+            result = -IO_ERROR;
+            goto out;
+        }
+
+        cluster_to_read = entry;
+    }
+
+    result = cluster_to_read;
+
+out:
+    return result;
+}
+
+// FAT is cached in memory, no disk access here
+static int get_fat_entry(struct disk* disk, int cluster) {
+    struct fat_private_data* private_data = disk->filesystem_private_data;
+    if (!private_data->fat_table || cluster < 0 || cluster >= private_data->total_fat_entries) {
+        return -IO_ERROR;
+    }
+
+    return get_cached_fat_entry(private_data, cluster);
+}
+
+// Update cached FAT and bitmap, then write the FAT sector containing the entry to every FAT copy
+static int set_fat_entry(struct disk* disk, int cluster, int value) {
+    struct fat_private_data* private_data = disk->filesystem_private_data;
+
+    if (!private_data->fat_table || cluster < FAT_FIRST_DATA_CLUSTER || cluster >= private_data->total_fat_entries) {
+        return -IO_ERROR;
+    }
+
+    set_cached_fat_entry(private_data, cluster, value);
+
+    return write_fat_sectors(disk, cluster, cluster);
+}
+
+static uint32_t get_cached_fat_entry(struct fat_private_data* private_data, uint32_t cluster) {
+    if (private_data->fat_type == FAT_TYPE_FAT32) {
+        return ((uint32_t*) private_data->fat_table)[cluster] & FAT32_CLUSTER_MASK;
+    }
+
+    return ((uint16_t*) private_data->fat_table)[cluster];
+}
+
+// Bitmap follows the entry. Reserved top 4 bits of FAT32 entry are kept as they are
+static void set_cached_fat_entry(struct fat_private_data* private_data, uint32_t cluster, uint32_t value) {
+    if (private_data->fat_type == FAT_TYPE_FAT32) {
+        uint32_t* fat_table = private_data->fat_table;
+        fat_table[cluster] = (fat_table[cluster] & ~FAT32_CLUSTER_MASK) | (value & FAT32_CLUSTER_MASK);
+    } else {
+        ((uint16_t*) private_data->fat_table)[cluster] = value;
+    }
+
+    mark_cluster(private_data, cluster, value != FAT_UNUSED);
+}
+
+// Write FAT sectors holding entries of given clusters to every FAT copy, one multi-sector write per copy.
+// Whole sectors come from cached FAT, so no read-modify-write is needed.
+// Writes land in disk cache, so many appends updating the same FAT sector reach the disk once per flush
+static int write_fat_sectors(struct disk* disk, int first_cluster, int last_cluster) {
+    int result = 0;
+    struct fat_private_data* private_data = disk->filesystem_private_data;
+    struct primary_fat_header* primary_header = &private_data->header.primary_fat_header;
+    struct disk_stream* stream = private_data->write_stream;
+
+    int first_sector_in_fat = (first_cluster * private_data->fat_entry_size) / disk->sector_size;
+    int last_sector_in_fat = (last_cluster * private_data->fat_entry_size) / disk->sector_size;
+    char* fat_sectors = (char*) private_data->fat_table + first_sector_in_fat * disk->sector_size;
+    int total_bytes = (last_sector_in_fat - first_sector_in_fat + 1) * disk->sector_size;
+
+    for (int i = 0; i < primary_header->fat_copies; i++) {
+        int sector = get_first_fat_sector(private_data) + i * private_data->sectors_per_fat + first_sector_in_fat;
+        result = set_disk_stream_position(stream, convert_sector_to_absolute_byte(disk, sector));
+        if (result < 0) {
+            goto out;
+        }
+
+        result = write_to_disk_stream(stream, fat_sectors, total_bytes);
+        if (result < 0) {
+            goto out;
+        }
+    }
+
+out:
+    return result;
+}
+
+static int allocate_cluster(struct disk* disk, int preferred_cluster) {
+    int total_allocated_clusters = 0;
+    return allocate_cluster_run(disk, preferred_cluster, 1, &total_allocated_clusters);
+}
+
+// Allocate at most wanted_clusters physically continuous clusters, chained to each other and ended with end of chain mark.
+// Free clusters right after preferred cluster are taken first, so file grows in place.
+// Otherwise the first free run fitting all wanted clusters is used, or the largest one if none fits.
+// Return first cluster of the run, caller links it
+static int allocate_cluster_run(struct disk* disk, int preferred_cluster, int wanted_clusters, int* total_allocated_clusters) {
+    struct fat_private_data* private_data = disk->filesystem_private_data;
+    uint32_t start_cluster = preferred_cluster;
+    int total_clusters = 0;
+
+    if (start_cluster >= FAT_FIRST_DATA_CLUSTER && start_cluster < private_data->total_clusters) {
+        total_clusters = get_total_free_clusters_from(private_data, start_cluster, wanted_clusters);
+    }
+
+    if (total_clusters == 0) {
+        total_clusters = find_free_cluster_run(private_data, wanted_clusters, &start_cluster);
+        if (total_clusters == 0) {
+            return -NO_FREE_SPACE_ERROR;
+        }
+    }
+
+    uint32_t last_cluster = start_cluster + total_clusters - 1;
+    for (uint32_t cluster = start_cluster; cluster < last_cluster; cluster++) {
+        set_cached_fat_entry(private_data, cluster, cluster + 1);
+    }
+    set_cached_fat_entry(private_data, last_cluster, private_data->end_of_chain);
+
+    int result = write_fat_sectors(disk, start_cluster, last_cluster);
+    if (result < 0) {
+        return result;
+    }
+
+    if (last_cluster >= private_data->next_free_cluster_hint) {
+        private_data->next_free_cluster_hint = last_cluster + 1;
+    }
+
+    *total_allocated_clusters = total_clusters;
+    return start_cluster;
+}
+
+// count free clusters starting from given one, up to max_clusters
+static int get_total_free_clusters_from(struct fat_private_data* private_data, uint32_t cluster, int max_clusters) {
+    int total_clusters = 0;
+
+    while (total_clusters < max_clusters && cluster < private_data->total_clusters && !is_cluster_used(private_data, cluster)) {
+        cluster++;
+        total_clusters++;
+    }
+
+    return total_clusters;
+}
+
+// Scan from next free hint to end of disk, then from beginning to the hint.
+// Return length of chosen run(at most wanted_clusters), 0 if disk is full
+static int find_free_cluster_run(struct fat_private_data* private_data, int wanted_clusters, uint32_t* start_cluster) {
+    uint32_t hint = private_data->next_free_cluster_hint;
+    int largest_run_length = 0;
+
+    if (hint < FAT_FIRST_DATA_CLUSTER || hint >= private_data->total_clusters) {
+        hint = FAT_FIRST_DATA_CLUSTER;
+    }
+
+    if (find_free_cluster_run_in_range(private_data, hint, private_data->total_clusters, wanted_clusters, start_cluster, &largest_run_length)) {
+        return wanted_clusters;
+    }
+
+    if (find_free_cluster_run_in_range(private_data, FAT_FIRST_DATA_CLUSTER, hint, wanted_clusters, start_cluster, &largest_run_length)) {
+        return wanted_clusters;
+    }
+
+    return largest_run_length;
+}
+
+// Return true once a run fitting wanted_clusters found. Otherwise largest run so far is kept in start_cluster and largest_run_length.
+// Fully used bytes of bitmap are skipped 8 clusters a time
+static bool find_free_cluster_run_in_range(struct fat_private_data* private_data, uint32_t from_cluster, uint32_t to_cluster, int wanted_clusters, uint32_t* start_cluster, int* largest_run_length) {
+    uint32_t cluster = from_cluster;
+
+    while (cluster < to_cluster) {
+        if (cluster % 8 == 0 && cluster + 8 <= to_cluster && private_data->free_cluster_bitmap[cluster / 8] == 0xFF) {
+            cluster += 8;
+            continue;
+        }
+
+        if (is_cluster_used(private_data, cluster)) {
+            cluster++;
+            continue;
+        }
+
+        uint32_t run_start = cluster;
+        int run_length = 0;
+        while (cluster < to_cluster && run_length < wanted_clusters && !is_cluster_used(private_data, cluster)) {
+            cluster++;
+            run_length++;
+        }
+
+        if (run_length > *largest_run_length) {
+            *largest_run_length = run_length;
+            *start_cluster = run_start;
+        }
+
+        if (run_length >= wanted_clusters) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+// Free the whole chain. Continuous clusters are collected into a run, so FAT sectors of the run are written once
+static int free_cluster_chain(struct disk* disk, int cluster) {
+    int result = 0;
+    struct fat_private_data* private_data = disk->filesystem_private_data;
+    int run_start = 0;
+    int run_end = 0;
+
+    while (cluster >= FAT_FIRST_DATA_CLUSTER && cluster < private_data->reserved_cluster_start) {
+        int next_cluster = get_fat_entry(disk, cluster);
+        if (next_cluster < 0) {
+            result = next_cluster;
+            goto out;
+        }
+
+        set_cached_fat_entry(private_data, cluster, FAT_UNUSED);
+
+        // reuse freed clusters first, so data stays compact at the beginning of disk
+        if (cluster < private_data->next_free_cluster_hint) {
+            private_data->next_free_cluster_hint = cluster;
+        }
+
+        if (run_start != 0 && cluster == run_end + 1) {
+            run_end = cluster;
+        } else {
+            if (run_start != 0) {
+                result = write_fat_sectors(disk, run_start, run_end);
+                if (result < 0) {
+                    goto out;
+                }
+            }
+            run_start = cluster;
+            run_end = cluster;
+        }
+
+        cluster = next_cluster;
+    }
+
+    if (run_start != 0) {
+        result = write_fat_sectors(disk, run_start, run_end);
+    }
+
+out:
+    return result;
+}
+
+// Count clusters from given one to end of chain, and find the last one
+static int get_total_clusters_in_chain(struct disk* disk, int cluster, int* last_cluster) {
+    struct fat_private_data* private_data = disk->filesystem_private_data;
+    int total_clusters = 1;
+
+    while (1) {
+        int entry = get_fat_entry(disk, cluster);
+        if (entry < 0) {
+            return entry;
+        }
+
+        if (entry >= private_data->end_of_chain) {
+            break;
+        }
+
+        // free, reserved or bad cluster in the middle of chain, or chain loops forever
+        if (entry < FAT_FIRST_DATA_CLUSTER || entry >= private_data->reserved_cluster_start || total_clusters >= private_data->total_fat_entries) {
+            return -IO_ERROR;
+        }
+
+        cluster = entry;
+        total_clusters++;
+    }
+
+    *last_cluster = cluster;
+    return total_clusters;
+}
+
+static bool is_cluster_used(struct fat_private_data* private_data, uint32_t cluster) {
+    return private_data->free_cluster_bitmap[cluster / 8] & (1 << (cluster % 8));
+}
+
+// Free cluster count follows the bitmap, so FSInfo can be written back without scanning
+static void mark_cluster(struct fat_private_data* private_data, uint32_t cluster, bool used) {
+    if (!private_data->free_cluster_bitmap || cluster >= private_data->total_clusters || is_cluster_used(private_data, cluster) == used) {
+        return;
+    }
+
+    if (used) {
+        private_data->free_cluster_bitmap[cluster / 8] |= 1 << (cluster % 8);
+        private_data->total_free_clusters--;
+    } else {
+        private_data->free_cluster_bitmap[cluster / 8] &= ~(1 << (cluster % 8));
+        private_data->total_free_clusters++;
+    }
+
+    private_data->is_fs_info_dirty = true;
+}
+
+// Number of clusters comes from size of data area, and never exceeds entries FAT can hold.
+// Cluster 0 and 1 don't exist in data area, they are marked as used so allocation never picks them
+static int build_free_cluster_bitmap(struct disk* disk, struct fat_private_data* private_data) {
+    struct primary_fat_header* primary_header = &private_data->header.primary_fat_header;
+    uint32_t total_sectors = primary_header->num_of_sectors != 0 ? primary_header->num_of_sectors : primary_header->sectors_big;
+    uint32_t total_data_sectors = total_sectors - private_data->first_data_sector;
+    uint32_t total_clusters = total_data_sectors / primary_header->sectors_per_cluster + FAT_FIRST_DATA_CLUSTER;
+
+    if (total_clusters > private_data->total_fat_entries) {
+        total_clusters = private_data->total_fat_entries;
+    }
+
+    private_data->free_cluster_bitmap = kzalloc((total_clusters + 7) / 8);
+    if (!private_data->free_cluster_bitmap) {
+        return -NO_FREE_MEM_ERROR;
+    }
+
+    private_data->total_clusters = total_clusters;
+    private_data->total_free_clusters = total_clusters;
+    for (uint32_t cluster = 0; cluster < total_clusters; cluster++) {
+        if (cluster < FAT_FIRST_DATA_CLUSTER || get_cached_fat_entry(private_data, cluster) != FAT_UNUSED) {
+            mark_cluster(private_data, cluster, true);
+        }
+    }
+
+    private_data->next_free_cluster_hint = FAT_FIRST_DATA_CLUSTER;
+    private_data->is_fs_info_dirty = false;
+
+    return ALL_OK;
+}
+
+// Load the first FAT copy(sectors_per_fat sectors) in a single read.
+// Any FAT update should go through this table and then be written to disk, keeping it write-through
+static int load_fat_table(struct disk* disk, struct fat_private_data* private_data) {
+    int result = 0;
+    struct disk_stream* stream = private_data->fat_read_stream;
+    int fat_table_size = private_data->sectors_per_fat * disk->sector_size;
+
+    private_data->fat_table = kzalloc(fat_table_size);
+    if (!private_data->fat_table) {
+        result = -NO_FREE_MEM_ERROR;
+        goto out;
+    }
+
+    result = set_disk_stream_position(stream, get_first_fat_sector(private_data) * disk->sector_size);
+    if (result < 0) {
+        goto out;
+    }
+
+    result = read_from_disk_stream(stream, private_data->fat_table, fat_table_size);
+    if (result < 0) {
+        goto out;
+    }
+
+    private_data->total_fat_entries = fat_table_size / private_data->fat_entry_size;
+
+out:
+    return result;
+}
+
+static uint32_t get_first_fat_sector(struct fat_private_data* private_data) {
+    return private_data->header.primary_fat_header.reserved_sectors;
+}
+
+void free_directory(struct fat_directory* directory) {
+    if (!directory) {
+        return;
+    }
+
+    free_directory_contents(directory);
+    kfree(directory);
+}
+
+static void free_directory_contents(struct fat_directory* directory) {
+    if (directory->item) {
+        kfree(directory->item);
+    }
+
+    if (directory->name_index) {
+        kfree(directory->name_index);
+    }
+
+    if (directory->long_names) {
+        kfree(directory->long_names);
+    }
+
+    if (directory->long_name_offsets) {
+        kfree(directory->long_name_offsets);
+    }
+
+    if (directory->item_slots) {
+        kfree(directory->item_slots);
+    }
+}
+
+struct fat_directory* clone_directory(struct fat_directory* directory) {
+    struct fat_directory* copied_directory = kzalloc(sizeof(struct fat_directory));
+    if (!copied_directory) {
+        return 0;
+    }
+
+    memcpy(copied_directory, directory, sizeof(struct fat_directory));
+    copied_directory->item = 0;
+    copied_directory->name_index = 0;
+    copied_directory->long_names = 0;
+    copied_directory->long_name_offsets = 0;
+    copied_directory->item_slots = 0;
+
+    // empty directory can be opened too, heap never hands out 0 bytes
+    int directory_size = directory->total_num_of_items * sizeof(struct fat_directory_item);
+    copied_directory->item = kzalloc(directory_size > 0 ? directory_size : sizeof(struct fat_directory_item));
+    if (!copied_directory->item) {
+        free_directory(copied_directory);
+        return 0;
+    }
+
+    memcpy(copied_directory->item, directory->item, directory_size);
+
+    int name_index_size = directory->name_index_size * sizeof(int);
+    copied_directory->name_index = kzalloc(name_index_size);
+    if (!copied_directory->name_index) {
+        free_directory(copied_directory);
+        return 0;
+    }
+
+    memcpy(copied_directory->name_index, directory->name_index, name_index_size);
+
+    int long_name_offsets_size = (directory->total_num_of_items + 1) * sizeof(int);
+    copied_directory->long_name_offsets = kzalloc(long_name_offsets_size);
+    if (!copied_directory->long_name_offsets) {
+        free_directory(copied_directory);
+        return 0;
+    }
+
+    memcpy(copied_directory->long_name_offsets, directory->long_name_offsets, long_name_offsets_size);
+
+    copied_directory->item_slots = kzalloc(long_name_offsets_size);
+    if (!copied_directory->item_slots) {
+        free_directory(copied_directory);
+        return 0;
+    }
+
+    memcpy(copied_directory->item_slots, directory->item_slots, long_name_offsets_size);
+
+    if (directory->long_names) {
+        copied_directory->long_names = kzalloc(directory->long_names_size);
+        if (!copied_directory->long_names) {
+            free_directory(copied_directory);
+            return 0;
+        }
+
+        memcpy(copied_directory->long_names, directory->long_names, directory->long_names_size);
+    }
+
+    return copied_directory;
+}
+
+struct fat_directory_item* clone_directory_item(struct fat_directory_item* directory_item, int size) {
+    struct fat_directory_item* copied_item = 0;
+
+    if(size < sizeof(struct fat_directory_item)) {
+        return 0;
+    }
+
+    copied_item = kzalloc(size);
+
+    if(!copied_item) {
+        return 0;
+    }
+
+    memcpy(copied_item, directory_item, size);
+
+    return copied_item;
+}
+
+void free_fat_item(struct fat_item* item) {
+    if (item->item_type == FAT_ITEM_TYPE_DIRECTORY) {
+        free_directory(item->directory);
+    } else if (item->item_type == FAT_ITEM_TYPE_FILE) {
+        kfree(item->item);
+    } else {
+        // should throw kernel panic
+    }
+
+    kfree(item);
+}
+
+// All blocks are read as one transfer clamped to end of file, then file position moves past the data read,
+// so consecutive reads stream through the file
+int fat_read(struct disk* disk, void* descriptor, uint32_t num_of_bytes, uint32_t num_of_blocks, char* out_ptr) {
+    struct fat_file_descriptor* fat_descriptor = descriptor;
+
+    int result = fat_read_at(disk, fat_descriptor, num_of_bytes * num_of_blocks, fat_descriptor->position, out_ptr);
+    if (result > 0) {
+        fat_descriptor->position += result;
+    }
+
+    return result;
+}
+
+// Extend cluster chain first if write goes beyond allocated clusters, write data extent by extent,
+// then write back file size and first cluster in directory item. Append mode always writes from end of file
+int fat_write(struct disk* disk, void* descriptor, uint32_t num_of_bytes, uint32_t num_of_blocks, const char* in_ptr) {
+    int result = 0;
+    struct fat_file_descriptor* fat_descriptor = descriptor;
+
+    if (fat_descriptor->mode == FILE_MODE_READ || fat_descriptor->item->item_type != FAT_ITEM_TYPE_FILE) {
+        result = -READ_ONLY_ERROR;
+        goto out;
+    }
+
+    struct fat_directory_item* item = fat_descriptor->item->item;
+    if (fat_descriptor->mode == FILE_MODE_APPEND) {
+        fat_descriptor->position = item->filesize;
+    }
+
+    // rejected before anything is allocated, so a wrapped size never shrinks the write
+    if (num_of_blocks != 0 && num_of_bytes > FILE_MAX_TRANSFER_BYTES / num_of_blocks) {
+        result = -INVALID_ARG_ERROR;
+        goto out;
+    }
+
+    uint32_t total_bytes_to_write = num_of_bytes * num_of_blocks;
+    uint32_t end_position = fat_descriptor->position + total_bytes_to_write;
+    if (end_position < fat_descriptor->position) {
+        result = -INVALID_ARG_ERROR;
+        goto out;
+    }
+
+    result = extend_file(disk, fat_descriptor, end_position);
+    if (result < 0) {
+        goto out;
+    }
+
+    result = write_data_to_file(disk, fat_descriptor, fat_descriptor->position, total_bytes_to_write, in_ptr);
+    if (result < 0) {
+        goto out;
+    }
+
+    fat_descriptor->position = end_position;
+
+    // only grown file changes its directory item, first cluster is set when file grows from empty
+    if (end_position > item->filesize) {
+        item->filesize = end_position;
+        result = write_directory_item(disk, fat_descriptor->parent_cluster, fat_descriptor->item_slot, item);
+        if (result < 0) {
+            goto out;
+        }
+    }
+
+    result = total_bytes_to_write;
+out:
+    return result;
+}
+
+// Read at most up to end of file. Shared file position is left untouched, cluster cursor is only a lookup cache
+int fat_read_at(struct disk* disk, void* descriptor, uint32_t num_of_bytes, FILE_POSITION position, char* out_ptr) {
+    int result = 0;
+    struct fat_file_descriptor* fat_descriptor = descriptor;
+
+    if (fat_descriptor->item->item_type != FAT_ITEM_TYPE_FILE) {
+        result = -INVALID_ARG_ERROR;
+        goto out;
+    }
+
+    struct fat_directory_item* item = fat_descriptor->item->item;
+    if (position >= item->filesize) {
+        goto out;
+    }
+
+    uint32_t total_bytes_to_read = item->filesize - position;
+    if (total_bytes_to_read > num_of_bytes) {
+        total_bytes_to_read = num_of_bytes;
+    }
+
+    result = read_data_from_file(disk, fat_descriptor, position, total_bytes_to_read, out_ptr);
+    if (result < 0) {
+        goto out;
+    }
+
+    result = total_bytes_to_read;
+out:
+    return result;
+}
+
+// Relative seek is validated by where it lands, so seeking backwards works.
+// Position can be anywhere from beginning to end of file, end of file included
+int fat_seek(void* private_descriptor, FILE_OFFSET offset, FILE_SEEK_MODE seek_mode) {
+    int result = 0;
+    struct fat_file_descriptor* descriptor = private_descriptor;
+    struct fat_item* descriptor_item = descriptor->item;
+
+    if (descriptor_item->item_type != FAT_ITEM_TYPE_FILE) {
+        result = -INVALID_ARG_ERROR;
+        goto out;
+    }
+
+    struct fat_directory_item* item = descriptor_item->item;
+    FILE_OFFSET base = 0;
+    switch (seek_mode) {
+        case SEEK_SET:
+            base = 0;
+            break;
+
+        case SEEK_CURRENT:
+            base = descriptor->position;
+            break;
+
+        case SEEK_END:
+            base = item->filesize;
+            break;
+
+        default:
+            result = -INVALID_ARG_ERROR;
+            goto out;
+    }
+
+    FILE_OFFSET new_position = base + offset;
+    if (new_position < 0 || new_position > item->filesize) {
+        result = -INVALID_ARG_ERROR;
+        goto out;
+    }
+
+    descriptor->position = new_position;
+out:
+    return result;
+}
+
+int fat_stat(struct disk* disk, void* private, struct file_stat* stat) {
+    int result = 0;
+    struct fat_file_descriptor* descriptor = (struct fat_file_descriptor*) private;
+    struct fat_item* descriptor_item = descriptor->item;
+
+    if (descriptor_item->item_type != FAT_ITEM_TYPE_FILE) {
+        result = -INVALID_ARG_ERROR;
+        goto out;
+    }
+
+    struct fat_directory_item* directory_item = descriptor_item->item;
+    stat->file_size = directory_item->filesize;
+    stat->flags = 0x00;
+
+    if (directory_item->attribute & FAT_FILE_READ_ONLY) {
+        stat->flags |= FILE_STAT_READ_ONLY;
+    }
+
+out:
+    return result;
+}
+
+int fat_close(void* private_data) {
+    struct fat_file_descriptor* descriptor = private_data;
+
+    // descriptor is freed anyway, failing here only leaks the preallocated clusters
+    if (descriptor->has_preallocated_clusters) {
+        release_preallocated_clusters(descriptor->disk, descriptor);
+    }
+
+    // FSInfo holds only hints, stale one is fine
+    if (descriptor->mode != FILE_MODE_READ) {
+        write_fs_info(descriptor->disk);
+    }
+
+    free_file_descriptor(descriptor);
+
+    return 0;
+}
+
+static void free_file_descriptor(struct fat_file_descriptor* descriptor) {
+    free_fat_item(descriptor->item);
+    kfree(descriptor);
+}
+
+void* fat_open_directory(struct disk* disk, struct path_part* path) {
+    struct fat_private_data* private_data = disk->filesystem_private_data;
+    struct fat_directory_descriptor* descriptor = 0;
+    int error_code = 0;
+
+    descriptor = kzalloc(sizeof(struct fat_directory_descriptor));
+    if (!descriptor) {
+        error_code = -NO_FREE_MEM_ERROR;
+        goto error_out;
+    }
+
+    if (!path) {
+        descriptor->directory = clone_directory(&private_data->root_directory);
+        if (!descriptor->directory) {
+            error_code = -NO_FREE_MEM_ERROR;
+            goto error_out;
+        }
+
+        return descriptor;
+    }
+
+    struct fat_item* item = get_directory_entry(disk, path);
+    if (!item) {
+        error_code = -IO_ERROR;
+        goto error_out;
+    }
+
+    if (item->item_type != FAT_ITEM_TYPE_DIRECTORY) {
+        free_fat_item(item);
+        error_code = -INVALID_ARG_ERROR;
+        goto error_out;
+    }
+
+    // item only wraps the cloned directory
+    descriptor->directory = item->directory;
+    kfree(item);
+
+    return descriptor;
+
+error_out:
+    if (descriptor) {
+        kfree(descriptor);
+    }
+    return ERROR(error_code);
+}
+
+// Long name is returned if the item has one, otherwise "NAME.EXT" from 8.3 name
+int fat_read_directory(struct disk* disk, void* private_data, struct directory_entry* out, uint32_t size) {
+    struct fat_directory_descriptor* descriptor = private_data;
+    struct fat_directory* directory = descriptor->directory;
+    char short_name[FAT_SHORT_NAME_LENGTH + 2]; // dot and terminator
+    uint32_t total_bytes = 0;
+
+    while (descriptor->next_item_index < directory->total_num_of_items) {
+        struct fat_directory_item* item = &directory->item[descriptor->next_item_index];
+        const char* name = get_long_name_of_item(directory, descriptor->next_item_index);
+        if (!name) {
+            get_full_relative_filename(item, short_name, sizeof(short_name));
+            name = short_name;
+        }
+
+        // keep every entry 4 bytes aligned
+        uint32_t record_length = (sizeof(struct directory_entry) + strlen(name) + 1 + 3) & ~3;
+        if (total_bytes + record_length > size) {
+            break;
+        }
+
+        struct directory_entry* entry = (struct directory_entry*) ((char*) out + total_bytes);
+        entry->record_length = record_length;
+        entry->flags = 0x00;
+        entry->file_size = item->filesize;
+        if (item->attribute & FAT_FILE_SUBDIRECTORY) {
+            entry->flags |= FILE_STAT_DIRECTORY;
+        }
+        if (item->attribute & FAT_FILE_READ_ONLY) {
+            entry->flags |= FILE_STAT_READ_ONLY;
+        }
+        strcpy(entry->name, name);
+
+        total_bytes += record_length;
+        descriptor->next_item_index++;
+    }
+
+    // entry which can never fit would stop listing forever
+    if (total_bytes == 0 && descriptor->next_item_index < directory->total_num_of_items) {
+        return -INVALID_ARG_ERROR;
+    }
+
+    return total_bytes;
+}
+
+int fat_close_directory(void* private_data) {
+    struct fat_directory_descriptor* descriptor = private_data;
+    free_directory(descriptor->directory);
+    kfree(descriptor);
+
+    return 0;
+}
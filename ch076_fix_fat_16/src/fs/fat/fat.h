@@ -0,0 +1,10 @@
+#ifndef FAT_H
+#define FAT_H
+
+#include "file.h"
+
+struct filesystem* initialize_fat16_filesystem();
+// FAT32 is handled by the same driver
+struct filesystem* initialize_fat32_filesystem();
+
+#endif
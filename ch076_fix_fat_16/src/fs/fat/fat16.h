@@ -1,8 +0,0 @@
-#ifndef FAT16_H
-#define FAT16_H
-
-#include "file.h"
-
-struct filesystem* initialize_fat16_filesystem();
-
-#endif
@@ -5,12 +5,17 @@
 #include "status.h"
 #include "kernel.h"
 #include "disk/disk.h"
+#include "disk/disk_cache.h"
 #include "string/string.h"
 
-#include "fat/fat16.h"
+#include "fat/fat.h"
+#include "ramfs/ramfs.h"
 
 struct filesystem* filesystems[MAX_FILESYSTEMS];
-struct file_descriptor* file_descriptors[MAX_FILE_DESCRIPTORS];
+// descriptors opened by kernel itself, e.g. while loading programs
+static struct file_table kernel_file_table;
+// indexed by drive number
+static struct mount mounts[MAX_MOUNTS];
 
 static struct filesystem** get_free_filesystem();
 
@@ -19,7 +24,10 @@ static void statically_load_filesystem();
 
 FILE_MODE get_file_mode_by_string(const char* mode_string);
 
-static void free_file_descriptor(struct file_descriptor* descriptor);
+static int insert_file_descriptor(struct file_table* table, struct file_descriptor* descriptor);
+static struct file_descriptor* get_file_descriptor(struct file_table* table, int file_descriptor_index);
+static struct file_descriptor* get_file_descriptor_of_type(struct file_table* table, int file_descriptor_index, bool is_directory);
+static int release_file_descriptor(struct file_table* table, int file_descriptor_index);
 
 void insert_filesystem(struct filesystem* filesystem) {
     struct filesystem** fs;
@@ -42,7 +50,8 @@ static struct filesystem** get_free_filesystem() {
 }
 
 void fs_init() {
-    memset(file_descriptors, 0, sizeof(file_descriptors));
+    memset(&kernel_file_table, 0, sizeof(kernel_file_table));
+    memset(mounts, 0, sizeof(mounts));
     load_filesystems();
 }
 
@@ -53,33 +62,169 @@ void load_filesystems() {
 
 static void statically_load_filesystem() {
     insert_filesystem(initialize_fat16_filesystem());
+    insert_filesystem(initialize_fat32_filesystem());
+    insert_filesystem(initialize_ramfs_filesystem());
 }
 
-int create_new_file_descriptor(struct file_descriptor** target_file_descriptor) {
-    int result = -NO_FREE_MEM_ERROR;
-    for (int i = 0; i < MAX_FILE_DESCRIPTORS; i++) {
-        if (file_descriptors[i] == 0) {
-            struct file_descriptor* new_file_descriptor = kzalloc(sizeof(struct file_descriptor));
-            // Descriptor starts from 1
-            new_file_descriptor -> index = i + 1;
-            file_descriptors[i] = new_file_descriptor;
-            *target_file_descriptor = new_file_descriptor;
-            result = 0;
-            break;
-        }
+// Resolve filesystem on disk, and make it reachable through drive_num.
+// Filesystem private data lives on the disk, so a disk is mounted on one drive at most
+int mount_disk(int drive_num, struct disk* disk) {
+    int result = 0;
+    if (drive_num < 0 || drive_num >= MAX_MOUNTS || !disk) {
+        result = -INVALID_ARG_ERROR;
+        goto out;
+    }
+
+    if (mounts[drive_num].disk || disk->filesystem) {
+        result = -IS_TAKEN_ERROR;
+        goto out;
+    }
+
+    // filesystem sets disk->filesystem_private_data while resolving
+    disk->filesystem = resolve_filesystem(disk);
+    if (!disk->filesystem) {
+        result = -INVALID_FS_SIGNATURE_ERROR;
+        goto out;
+    }
+
+    struct mount* mount = &mounts[drive_num];
+    mount->disk = disk;
+    mount->filesystem = disk->filesystem;
+    mount->filesystem_private_data = disk->filesystem_private_data;
+    mount->total_open_descriptors = 0;
+
+out:
+    return result;
+}
+
+// Cached writes reach the disk before the drive is released, so the disk can be mounted again or removed
+int unmount_disk(int drive_num) {
+    int result = 0;
+    struct mount* mount = get_mount(drive_num);
+    if (!mount) {
+        result = -INVALID_ARG_ERROR;
+        goto out;
+    }
+
+    if (mount->total_open_descriptors > 0) {
+        result = -IS_TAKEN_ERROR;
+        goto out;
+    }
+
+    // disk stays mounted if dirty sectors can't be written, so nothing is lost yet
+    struct disk* disk = mount->disk;
+    result = flush_disk_cache(disk);
+    if (result < 0) {
+        goto out;
     }
 
+    // Filesystem has released its private data once unmount ran, even if it failed on the way,
+    // so the mount entry must go away whatever it returned. Error is still reported.
+    // Whatever unmount wrote(e.g. FAT32 FSInfo) is flushed too
+    if (mount->filesystem->unmount) {
+        result = mount->filesystem->unmount(disk);
+    }
+
+    int flush_result = flush_disk_cache(disk);
+    if (result >= 0) {
+        result = flush_result;
+    }
+
+    disk->filesystem = 0;
+    disk->filesystem_private_data = 0;
+    memset(mount, 0, sizeof(struct mount));
+
+out:
     return result;
 }
 
-static struct file_descriptor* get_file_descriptor(int file_descriptor_index) {
-    if (file_descriptor_index <= 0 || file_descriptor_index >= MAX_FILE_DESCRIPTORS) {
+// Drive number indexes mount table directly. Return 0 if nothing is mounted on the drive
+struct mount* get_mount(int drive_num) {
+    if (drive_num < 0 || drive_num >= MAX_MOUNTS || !mounts[drive_num].disk) {
+        return 0;
+    }
+
+    return &mounts[drive_num];
+}
+
+struct file_table* get_kernel_file_table() {
+    return &kernel_file_table;
+}
+
+// Lowest free index comes from the first bitmap word which isn't full, a single bit scan finds the slot in it.
+// Return descriptor, which starts from 1
+static int insert_file_descriptor(struct file_table* table, struct file_descriptor* descriptor) {
+    for (int i = 0; i < FILE_TABLE_BITMAP_WORDS; i++) {
+        if (table->used_bitmap[i] == 0xFFFFFFFF) {
+            continue;
+        }
+
+        int index = i * 32 + __builtin_ctz(~table->used_bitmap[i]);
+        table->used_bitmap[i] |= 1u << (index % 32);
+        table->descriptors[index] = descriptor;
+        return index + 1;
+    }
+
+    return -NO_FREE_MEM_ERROR;
+}
+
+static struct file_descriptor* get_file_descriptor(struct file_table* table, int file_descriptor_index) {
+    if (!table || file_descriptor_index <= 0 || file_descriptor_index > MAX_FILE_DESCRIPTORS) {
         return 0;
     }
 
     // Descriptor starts from 1
     int real_index = file_descriptor_index - 1;
-    return file_descriptors[real_index];
+    return table->descriptors[real_index];
+}
+
+// file operations never get a directory descriptor and vice versa, their private data differ
+static struct file_descriptor* get_file_descriptor_of_type(struct file_table* table, int file_descriptor_index, bool is_directory) {
+    struct file_descriptor* descriptor = get_file_descriptor(table, file_descriptor_index);
+    if (!descriptor || descriptor->is_directory != is_directory) {
+        return 0;
+    }
+
+    return descriptor;
+}
+
+// Close opened file and remove its descriptor from the table.
+// If closing fails, descriptor stays so it can be closed again
+static int release_file_descriptor(struct file_table* table, int file_descriptor_index) {
+    int result = 0;
+    int real_index = file_descriptor_index - 1;
+    struct file_descriptor* descriptor = table->descriptors[real_index];
+
+    if (descriptor->is_directory) {
+        result = descriptor->filesystem->close_directory(descriptor->private);
+    } else {
+        result = descriptor->filesystem->close(descriptor->private);
+    }
+
+    if (result != ALL_OK) {
+        goto out;
+    }
+
+    descriptor->mount->total_open_descriptors--;
+    kfree(descriptor);
+
+    table->descriptors[real_index] = 0x00;
+    table->used_bitmap[real_index / 32] &= ~(1u << (real_index % 32));
+
+out:
+    return result;
+}
+
+// Owner of the table is going away, e.g. process exits. Every descriptor left open is closed
+void close_file_table(struct file_table* table) {
+    for (int i = 0; i < FILE_TABLE_BITMAP_WORDS; i++) {
+        uint32_t used = table->used_bitmap[i];
+        while (used) {
+            int bit = __builtin_ctz(used);
+            used &= used - 1;
+            release_file_descriptor(table, i * 32 + bit + 1);
+        }
+    }
 }
 
 struct filesystem* resolve_filesystem(struct disk* disk) {
@@ -93,34 +238,28 @@ struct filesystem* resolve_filesystem(struct disk* disk) {
     return target_filesystem;
 }
 
-int fopen(const char* filename, const char* mode_string) {
+int fopen(struct file_table* table, const char* filename, const char* mode_string) {
     int result = 0;
 
-    struct path_root* root_path = parse_path_string_to_path_part(filename, NULL);
-
-    if (!root_path) {
-        result = -INVALID_ARG_ERROR;
+    struct path_root root_path;
+    result = parse_path(filename, &root_path);
+    if (result < 0) {
         goto out;
     }
 
     // Directly open root path (e.g., 1:/) is invalid
-    if (!root_path->first) {
+    if (!root_path.first) {
         result = -INVALID_ARG_ERROR;
         goto out;
     }
 
-    // check disk exist
-    struct disk* disk = get_disk(root_path->drive_num);
-    if (!disk) {
-        result = -IO_ERROR;
-        goto out;
-    }
-
-    // check disk contains/binds filesystem
-    if (!disk->filesystem) {
+    // check drive has filesystem mounted
+    struct mount* mount = get_mount(root_path.drive_num);
+    if (!mount) {
         result = -IO_ERROR;
         goto out;
     }
+    struct disk* disk = mount->disk;
 
     FILE_MODE file_mode = get_file_mode_by_string(mode_string);
     if (file_mode == FILE_MODE_INVALID) {
@@ -128,21 +267,30 @@ int fopen(const char* filename, const char* mode_string) {
         goto out;
     }
 
-    void *file_descriptor_private_data = disk->filesystem->open(disk, root_path->first, file_mode);
+    void *file_descriptor_private_data = mount->filesystem->open(disk, root_path.first, file_mode);
     if (IS_ERROR(file_descriptor_private_data)) {
         result = INT_ERROR(file_descriptor_private_data);
         goto out;
     }
 
-    struct file_descriptor* descriptor = 0;
-    result = create_new_file_descriptor(&descriptor);
-    if (result < 0) {
+    struct file_descriptor* descriptor = kzalloc(sizeof(struct file_descriptor));
+    if (!descriptor) {
+        mount->filesystem->close(file_descriptor_private_data);
+        result = -NO_FREE_MEM_ERROR;
         goto out;
     }
-    descriptor->filesystem = disk->filesystem;
+    descriptor->mount = mount;
+    descriptor->filesystem = mount->filesystem;
     descriptor->private = file_descriptor_private_data;
     descriptor->disk = disk;
-    result = descriptor->index;
+
+    result = insert_file_descriptor(table, descriptor);
+    if (result < 0) {
+        mount->filesystem->close(file_descriptor_private_data);
+        kfree(descriptor);
+        goto out;
+    }
+    mount->total_open_descriptors++;
 out:
     // fopen never fail, just return 0 in worst case
     if (result < 0) {
@@ -165,14 +313,14 @@ FILE_MODE get_file_mode_by_string(const char* mode_string) {
     return file_mode;
 }
 
-int fread(void* ptr, uint32_t num_of_bytes, uint32_t num_of_blocks, int file_descriptor_index) {
+int fread(struct file_table* table, void* ptr, uint32_t num_of_bytes, uint32_t num_of_blocks, int file_descriptor_index) {
     int result = 0;
     if (num_of_bytes == 0 || num_of_blocks == 0 || file_descriptor_index < 1) {
         result = -INVALID_ARG_ERROR;
         goto out;
     }
 
-    struct file_descriptor* descriptor = get_file_descriptor(file_descriptor_index);
+    struct file_descriptor* descriptor = get_file_descriptor_of_type(table, file_descriptor_index, false);
     if (!descriptor) {
         result = -INVALID_ARG_ERROR;
         goto out;
@@ -183,11 +331,35 @@ out:
     return result;
 }
 
-int fseek(int file_descriptor, int offset, FILE_SEEK_MODE whence) {
+int fwrite(struct file_table* table, const void* ptr, uint32_t num_of_bytes, uint32_t num_of_blocks, int file_descriptor_index) {
+    int result = 0;
+    if (num_of_bytes == 0 || num_of_blocks == 0 || file_descriptor_index < 1) {
+        result = -INVALID_ARG_ERROR;
+        goto out;
+    }
+
+    struct file_descriptor* descriptor = get_file_descriptor_of_type(table, file_descriptor_index, false);
+    if (!descriptor) {
+        result = -INVALID_ARG_ERROR;
+        goto out;
+    }
+
+    // read only filesystem
+    if (!descriptor->filesystem->write) {
+        result = -IO_ERROR;
+        goto out;
+    }
+
+    result = descriptor->filesystem->write(descriptor->disk, descriptor->private, num_of_bytes, num_of_blocks, (const char*) ptr);
+out:
+    return result;
+}
+
+int fseek(struct file_table* table, int file_descriptor, FILE_OFFSET offset, FILE_SEEK_MODE whence) {
     int result = 0;
-    struct file_descriptor* descriptor = get_file_descriptor(file_descriptor);
+    struct file_descriptor* descriptor = get_file_descriptor_of_type(table, file_descriptor, false);
     if (!descriptor) {
-        result = IO_ERROR;
+        result = -IO_ERROR;
         goto out;
     }
 
@@ -196,9 +368,33 @@ out:
     return result;
 }
 
-int fstat(int file_descriptor, struct file_stat* stat) {
+// Positional read, file position is not used nor changed. Return bytes read, 0 at end of file
+int pread(struct file_table* table, int file_descriptor, void* ptr, uint32_t num_of_bytes, FILE_POSITION position) {
+    int result = 0;
+    if (num_of_bytes == 0) {
+        result = -INVALID_ARG_ERROR;
+        goto out;
+    }
+
+    struct file_descriptor* descriptor = get_file_descriptor_of_type(table, file_descriptor, false);
+    if (!descriptor) {
+        result = -INVALID_ARG_ERROR;
+        goto out;
+    }
+
+    if (!descriptor->filesystem->read_at) {
+        result = -IO_ERROR;
+        goto out;
+    }
+
+    result = descriptor->filesystem->read_at(descriptor->disk, descriptor->private, num_of_bytes, position, (char*) ptr);
+out:
+    return result;
+}
+
+int fstat(struct file_table* table, int file_descriptor, struct file_stat* stat) {
     int result = 0;
-    struct file_descriptor* descriptor = get_file_descriptor(file_descriptor);
+    struct file_descriptor* descriptor = get_file_descriptor_of_type(table, file_descriptor, false);
     if (!descriptor) {
         result = -IO_ERROR;
         goto out;
@@ -210,26 +406,113 @@ out:
     return result;
 }
 
-int fclose(int file_descriptor) {
+int fclose(struct file_table* table, int file_descriptor) {
     int result = 0;
-    struct file_descriptor* descriptor = get_file_descriptor(file_descriptor);
+    struct file_descriptor* descriptor = get_file_descriptor_of_type(table, file_descriptor, false);
     if (!descriptor) {
         result = -IO_ERROR;
         goto out;
     }
 
-    result = descriptor->filesystem->close(descriptor->private);
+    result = release_file_descriptor(table, file_descriptor);
 
-    // free slot from global file descriptor array
-    if (result == ALL_OK) {
-        free_file_descriptor(descriptor);
+out:
+    return result;
+}
+
+// write everything cached for the disk file lives on
+int fsync(struct file_table* table, int file_descriptor) {
+    int result = 0;
+    struct file_descriptor* descriptor = get_file_descriptor(table, file_descriptor);
+    if (!descriptor) {
+        result = -IO_ERROR;
+        goto out;
     }
 
-    out:
+    result = flush_disk_cache(descriptor->disk);
+
+out:
     return result;
 }
 
-static void free_file_descriptor(struct file_descriptor* descriptor) {
-    file_descriptors[descriptor->index - 1] = 0x00;
-    kfree(descriptor);
-}
\ No newline at end of file
+int sync() {
+    return flush_all_disk_caches();
+}
+
+int opendir(struct file_table* table, const char* path) {
+    int result = 0;
+
+    struct path_root root_path;
+    result = parse_path(path, &root_path);
+    if (result < 0) {
+        goto out;
+    }
+
+    struct mount* mount = get_mount(root_path.drive_num);
+    if (!mount || !mount->filesystem->open_directory) {
+        result = -IO_ERROR;
+        goto out;
+    }
+    struct disk* disk = mount->disk;
+
+    // root path (e.g., 0:/) has no part, and opens root directory
+    void* directory_private_data = mount->filesystem->open_directory(disk, root_path.first);
+    if (IS_ERROR(directory_private_data)) {
+        result = INT_ERROR(directory_private_data);
+        goto out;
+    }
+
+    struct file_descriptor* descriptor = kzalloc(sizeof(struct file_descriptor));
+    if (!descriptor) {
+        mount->filesystem->close_directory(directory_private_data);
+        result = -NO_FREE_MEM_ERROR;
+        goto out;
+    }
+    descriptor->mount = mount;
+    descriptor->filesystem = mount->filesystem;
+    descriptor->private = directory_private_data;
+    descriptor->disk = disk;
+    descriptor->is_directory = true;
+
+    result = insert_file_descriptor(table, descriptor);
+    if (result < 0) {
+        mount->filesystem->close_directory(directory_private_data);
+        kfree(descriptor);
+        goto out;
+    }
+    mount->total_open_descriptors++;
+out:
+    // same as fopen, 0 in worst case
+    if (result < 0) {
+        result = 0;
+    }
+    return result;
+}
+
+// Batched like getdents: a single call returns as many entries as fit, so listing takes few calls
+int readdir(struct file_table* table, int directory_descriptor, struct directory_entry* out, uint32_t size) {
+    int result = 0;
+    struct file_descriptor* descriptor = get_file_descriptor_of_type(table, directory_descriptor, true);
+    if (!descriptor || !out) {
+        result = -INVALID_ARG_ERROR;
+        goto out;
+    }
+
+    result = descriptor->filesystem->read_directory(descriptor->disk, descriptor->private, out, size);
+out:
+    return result;
+}
+
+int closedir(struct file_table* table, int directory_descriptor) {
+    int result = 0;
+    struct file_descriptor* descriptor = get_file_descriptor_of_type(table, directory_descriptor, true);
+    if (!descriptor) {
+        result = -IO_ERROR;
+        goto out;
+    }
+
+    result = release_file_descriptor(table, directory_descriptor);
+
+out:
+    return result;
+}
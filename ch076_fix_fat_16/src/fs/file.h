@@ -1,7 +1,9 @@
 #ifndef FILE_H
 #define FILE_H
 #include "path_parser.h"
+#include "config.h"
 #include <stdint.h>
+#include <stdbool.h>
 
 typedef unsigned int FILE_SEEK_MODE;
 enum {
@@ -10,6 +12,11 @@ enum {
     SEEK_END
 };
 
+// Position in a file. FAT file size is 32 bit, so whole file is reachable
+typedef uint32_t FILE_POSITION;
+// Seek offset, negative when seeking backwards. 64 bit so any position can be reached from anywhere without overflow
+typedef int64_t FILE_OFFSET;
+
 typedef unsigned int FILE_MODE;
 enum {
     FILE_MODE_READ,
@@ -21,15 +28,41 @@ enum {
 typedef unsigned int FILE_STAT_FLAGS;
 enum {
     FILE_STAT_READ_ONLY = 0b00000001,
+    FILE_STAT_DIRECTORY = 0b00000010,
+};
+
+// Filled by readdir. Entries are packed one after another, record_length bytes from one entry to the next
+struct directory_entry {
+    uint16_t record_length;
+    uint16_t flags; // FILE_STAT_FLAGS
+    uint32_t file_size;
+    char name[]; // null terminated
 };
 
+// byte counts of a single read or write are returned as int
+#define FILE_MAX_TRANSFER_BYTES 0x7FFFFFFF
+
 struct disk;
 typedef void*(*FS_OPEN_FUNCTION)(struct disk* disk, struct path_part* path, FILE_MODE mode);
-// total bytes to read is num_of_bytes * num_of_blocks
+// total bytes to read is num_of_bytes * num_of_blocks, from file position which then advances.
+// Return bytes read, less than asked at end of file and 0 once file position reached end of file
 typedef int (*FS_READ_FUNCTION)(struct disk* disk, void* private_data, uint32_t num_of_bytes, uint32_t num_of_blocks, char* out);
-typedef int (*FS_SEEK_FUNCTION)(void* private, uint32_t offset, FILE_SEEK_MODE whence);
+// total bytes to write is num_of_bytes * num_of_blocks, from file position which then advances.
+// Return bytes written like read does. Total over FILE_MAX_TRANSFER_BYTES or past the largest position is rejected
+typedef int (*FS_WRITE_FUNCTION)(struct disk* disk, void* private_data, uint32_t num_of_bytes, uint32_t num_of_blocks, const char* in);
+// read from given position, file position stays as it is. Return bytes read, less than asked at end of file
+typedef int (*FS_READ_AT_FUNCTION)(struct disk* disk, void* private_data, uint32_t num_of_bytes, FILE_POSITION position, char* out);
+// resulting position must be within the file, end of file included
+typedef int (*FS_SEEK_FUNCTION)(void* private, FILE_OFFSET offset, FILE_SEEK_MODE whence);
 typedef int (*FS_RESOLVE_FUNCTION)(struct disk* disk); // Check disk valid or not
 typedef int (*FS_CLOSE_FUNCTION)(void* private);
+// path is null for root directory
+typedef void*(*FS_OPEN_DIRECTORY_FUNCTION)(struct disk* disk, struct path_part* path);
+// fill out with as many whole entries as fit in size bytes, return bytes filled. 0 once every entry was read
+typedef int (*FS_READ_DIRECTORY_FUNCTION)(struct disk* disk, void* private_data, struct directory_entry* out, uint32_t size);
+typedef int (*FS_CLOSE_DIRECTORY_FUNCTION)(void* private);
+// release filesystem private data set up by resolve, even if it fails. Nothing is open on the disk any more
+typedef int (*FS_UNMOUNT_FUNCTION)(struct disk* disk);
 
 struct file_stat {
     FILE_STAT_FLAGS flags;
@@ -42,17 +75,35 @@ struct filesystem {
     FS_RESOLVE_FUNCTION resolve;
     FS_OPEN_FUNCTION open;
     FS_READ_FUNCTION read;
+    FS_WRITE_FUNCTION write;
+    FS_READ_AT_FUNCTION read_at;
     FS_SEEK_FUNCTION seek;
     FS_STAT_FUNCTION stat;
     FS_CLOSE_FUNCTION close;
+    FS_OPEN_DIRECTORY_FUNCTION open_directory;
+    FS_READ_DIRECTORY_FUNCTION read_directory;
+    FS_CLOSE_DIRECTORY_FUNCTION close_directory;
+    FS_UNMOUNT_FUNCTION unmount;
 
     char name[20]; // filesystem name
 };
 
 
+// Filesystem on a disk, reachable through drive number in path (e.g., 1:/ for drive 1)
+struct mount {
+    // 0 if nothing is mounted on the drive
+    struct disk* disk;
+    struct filesystem* filesystem;
+    // same as disk->filesystem_private_data, drivers find it through the disk
+    void* filesystem_private_data;
+
+    // files and directories opened on the drive, it can't be unmounted before they are closed
+    int total_open_descriptors;
+};
+
+// Opened file, owned by the one descriptor table entry referring to it
 struct file_descriptor {
-    // descriptor index
-    int index;
+    struct mount* mount;
     struct filesystem* filesystem;
 
     // private data for internal file descriptor
@@ -60,14 +111,40 @@ struct file_descriptor {
 
     // disk file descriptor should be used on
     struct disk* disk;
+
+    // opened by opendir, private data belongs to directory operations
+    bool is_directory;
+};
+
+#define FILE_TABLE_BITMAP_WORDS (MAX_FILE_DESCRIPTORS / 32)
+
+// Descriptors of one owner, kernel or a process. Descriptor n lives at descriptors[n - 1],
+// bit set in used_bitmap marks the slot taken
+struct file_table {
+    struct file_descriptor* descriptors[MAX_FILE_DESCRIPTORS];
+    uint32_t used_bitmap[FILE_TABLE_BITMAP_WORDS];
 };
 
 void fs_init();
-int fopen(const char* filename, const char* mode_string);
-int fread(void* ptr, uint32_t num_of_bytes, uint32_t num_of_blocks, int file_descriptor);
-int fseek(int file_descriptor, int offset, FILE_SEEK_MODE whence);
-int fstat(int file_descriptor, struct file_stat* stat);
-int fclose(int file_descriptor);
+int mount_disk(int drive_num, struct disk* disk);
+int unmount_disk(int drive_num);
+struct mount* get_mount(int drive_num);
+struct file_table* get_kernel_file_table();
+void close_file_table(struct file_table* table);
+
+// descriptors are looked up in given table, see get_kernel_file_table and process file_table
+int fopen(struct file_table* table, const char* filename, const char* mode_string);
+int fread(struct file_table* table, void* ptr, uint32_t num_of_bytes, uint32_t num_of_blocks, int file_descriptor);
+int fwrite(struct file_table* table, const void* ptr, uint32_t num_of_bytes, uint32_t num_of_blocks, int file_descriptor);
+int fseek(struct file_table* table, int file_descriptor, FILE_OFFSET offset, FILE_SEEK_MODE whence);
+int pread(struct file_table* table, int file_descriptor, void* ptr, uint32_t num_of_bytes, FILE_POSITION position);
+int fstat(struct file_table* table, int file_descriptor, struct file_stat* stat);
+int fclose(struct file_table* table, int file_descriptor);
+int fsync(struct file_table* table, int file_descriptor);
+int sync();
+int opendir(struct file_table* table, const char* path);
+int readdir(struct file_table* table, int directory_descriptor, struct directory_entry* out, uint32_t size);
+int closedir(struct file_table* table, int directory_descriptor);
 
 void insert_filesystem(struct filesystem* filesystem);
 struct filesystem* resolve_filesystem(struct disk* disk);
@@ -1,16 +1,33 @@
 #ifndef PATH_PARSER_H
 #define PATH_PARSER_H
 
-struct path_root {
-    int drive_num;
-    struct path_part* first;
-};
+#include <stdint.h>
+#include "kernel.h"
+
+// every part takes at least one character and one divider
+#define MAX_PATH_PARTS (MAX_PATH_LENGTH / 2)
 
 struct path_part {
+    // null terminated, points into path_root->path
     const char* part;
+    // view of the part in the original path string
+    uint16_t offset;
+    uint16_t length;
     struct path_part* next;
 };
 
-struct path_root* parse_path_string_to_path_part(const char* path, const char* current_directory_path);
+// Parsed path owns everything it refers to, so it can live on the stack and needs no freeing
+struct path_root {
+    int drive_num;
+    // 0 for root path (e.g., 0:/)
+    struct path_part* first;
+    int total_parts;
+
+    // copy of the original path with dividers replaced by null terminators
+    char path[MAX_PATH_LENGTH + 1];
+    struct path_part parts[MAX_PATH_PARTS];
+};
+
+int parse_path(const char* path, struct path_root* root);
 
-#endif
\ No newline at end of file
+#endif
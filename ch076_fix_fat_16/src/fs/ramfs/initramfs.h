@@ -0,0 +1,31 @@
+#ifndef INITRAMFS_H
+#define INITRAMFS_H
+
+#include <stdint.h>
+
+// Boot image placed right after kernel on disk. boot.asm loads it to INITRAMFS_ADDRESS together with kernel,
+// and ramfs serves its files from drive 0. Layout: header, entry table, then file data. Built by tools/mkinitramfs.c
+#define INITRAMFS_SIGNATURE 0x53465249 // "IRFS"
+#define INITRAMFS_ADDRESS 0x00800000
+// sectors between kernel and FAT area, see KERNEL_SECTORS and ReservedSectors in boot.asm
+#define INITRAMFS_MAX_SECTORS (4096 - 1 - 400)
+#define INITRAMFS_MAX_SIZE (INITRAMFS_MAX_SECTORS * 512)
+#define INITRAMFS_NAME_LENGTH 56
+
+struct initramfs_header {
+    uint32_t signature;
+    // whole image in bytes, header included. Boot loader loads this many
+    uint32_t total_size;
+    uint32_t total_entries;
+    uint32_t reserved;
+} __attribute__((packed));
+
+struct initramfs_entry {
+    // null terminated path under root directory, e.g. "bin/shell.elf"
+    char name[INITRAMFS_NAME_LENGTH];
+    // from start of image
+    uint32_t offset;
+    uint32_t size;
+} __attribute__((packed));
+
+#endif
@@ -0,0 +1,578 @@
+#include "ramfs.h"
+#include "initramfs.h"
+#include "config.h"
+#include "status.h"
+#include "kernel.h"
+#include "disk/disk.h"
+#include "string/string.h"
+#include "memory/memory.h"
+#include "memory/heap/kheap.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+// File content is kept in separate heap blocks, so growing a file never moves data already written
+#define RAMFS_PAGE_SIZE HEAP_BLOCK_SIZE
+#define RAMFS_NAME_LENGTH 64
+
+// file or directory. Nodes are only freed on unmount, so descriptors can point to them directly
+struct ramfs_node {
+    char name[RAMFS_NAME_LENGTH];
+    bool is_directory;
+
+    // file content, page n holds bytes from n * RAMFS_PAGE_SIZE. Pages are allocated as file grows
+    uint32_t file_size;
+    void** pages;
+    uint32_t total_pages;
+    // entries pages array can hold
+    uint32_t pages_capacity;
+
+    // directory content in creation order
+    struct ramfs_node* first_child;
+    struct ramfs_node* next_sibling;
+};
+
+struct ramfs_private_data {
+    struct ramfs_node root_directory;
+};
+
+// represents opened file
+struct ramfs_file_descriptor {
+    struct ramfs_node* node;
+    FILE_POSITION position;
+    FILE_MODE mode;
+};
+
+// represents opened directory. Children are never removed, so listing just follows sibling links
+struct ramfs_directory_descriptor {
+    struct ramfs_node* next_child;
+};
+
+int resolve_ramfs_filesystem(struct disk* disk);
+void* ramfs_open(struct disk* disk, struct path_part* path, FILE_MODE mode);
+int ramfs_read(struct disk* disk, void* descriptor, uint32_t num_of_bytes, uint32_t num_of_blocks, char* out_ptr);
+int ramfs_write(struct disk* disk, void* descriptor, uint32_t num_of_bytes, uint32_t num_of_blocks, const char* in_ptr);
+int ramfs_read_at(struct disk* disk, void* descriptor, uint32_t num_of_bytes, FILE_POSITION position, char* out_ptr);
+int ramfs_seek(void* private_descriptor, FILE_OFFSET offset, FILE_SEEK_MODE seek_mode);
+int ramfs_stat(struct disk* disk, void* private, struct file_stat* stat);
+int ramfs_close(void* private_data);
+void* ramfs_open_directory(struct disk* disk, struct path_part* path);
+int ramfs_read_directory(struct disk* disk, void* private_data, struct directory_entry* out, uint32_t size);
+int ramfs_close_directory(void* private_data);
+int ramfs_unmount(struct disk* disk);
+
+static struct ramfs_node* find_child(struct ramfs_node* directory, const char* name);
+static struct ramfs_node* create_child(struct ramfs_node* directory, const char* name, bool is_directory);
+static struct ramfs_node* get_parent_directory(struct ramfs_node* root_directory, struct path_part* path, struct path_part** last_part);
+static int load_initramfs(struct ramfs_node* root_directory, struct initramfs_header* header);
+static struct ramfs_node* create_file_with_directories(struct ramfs_node* directory, const char* path);
+static int reserve_pages(struct ramfs_node* node, uint32_t size);
+static void copy_file_data(struct ramfs_node* node, FILE_POSITION position, uint32_t total_bytes, void* buffer, bool write);
+static void truncate_node(struct ramfs_node* node);
+static void free_node(struct ramfs_node* node);
+
+struct filesystem ramfs = {
+    .resolve = resolve_ramfs_filesystem,
+    .open = ramfs_open,
+    .read = ramfs_read,
+    .write = ramfs_write,
+    .read_at = ramfs_read_at,
+    .seek = ramfs_seek,
+    .stat = ramfs_stat,
+    .close = ramfs_close,
+    .open_directory = ramfs_open_directory,
+    .read_directory = ramfs_read_directory,
+    .close_directory = ramfs_close_directory,
+    .unmount = ramfs_unmount,
+};
+
+struct filesystem* initialize_ramfs_filesystem() {
+    strcpy(ramfs.name, "RAMFS");
+    return &ramfs;
+}
+
+// Any memory disk can hold ramfs. It starts with empty root directory,
+// or with files of the boot image if memory disk was made from one
+int resolve_ramfs_filesystem(struct disk* disk) {
+    int result = 0;
+    if (disk->disk_type != DISK_TYPE_MEMORY) {
+        result = -INVALID_FS_SIGNATURE_ERROR;
+        goto out;
+    }
+
+    struct ramfs_private_data* private_data = kzalloc(sizeof(struct ramfs_private_data));
+    if (!private_data) {
+        result = -NO_FREE_MEM_ERROR;
+        goto out;
+    }
+
+    private_data->root_directory.is_directory = true;
+    disk->filesystem_private_data = private_data;
+
+    if (disk->driver_private_data) {
+        result = load_initramfs(&private_data->root_directory, disk->driver_private_data);
+        if (result < 0) {
+            ramfs_unmount(disk);
+        }
+    }
+
+out:
+    return result;
+}
+
+// Files are copied into ramfs pages, so they can be written like any other file and image memory isn't needed afterwards
+static int load_initramfs(struct ramfs_node* root_directory, struct initramfs_header* header) {
+    // header and entry table must fit in the image. Divided instead of multiplied, so a huge entry count can't overflow
+    if (header->signature != INITRAMFS_SIGNATURE || header->total_size > INITRAMFS_MAX_SIZE ||
+        header->total_size < sizeof(struct initramfs_header) ||
+        header->total_entries > (header->total_size - sizeof(struct initramfs_header)) / sizeof(struct initramfs_entry)) {
+        return -INVALID_FORMAT_ERROR;
+    }
+
+    // file data only lives after the table
+    uint32_t table_end = sizeof(struct initramfs_header) + header->total_entries * sizeof(struct initramfs_entry);
+    struct initramfs_entry* entries = (struct initramfs_entry*) (header + 1);
+    for (uint32_t i = 0; i < header->total_entries; i++) {
+        struct initramfs_entry* entry = &entries[i];
+        if (entry->offset < table_end || entry->offset > header->total_size || entry->size > header->total_size - entry->offset ||
+            strlen_max(entry->name, INITRAMFS_NAME_LENGTH) == INITRAMFS_NAME_LENGTH) {
+            return -INVALID_FORMAT_ERROR;
+        }
+
+        struct ramfs_node* node = create_file_with_directories(root_directory, entry->name);
+        if (!node) {
+            return -INVALID_FORMAT_ERROR;
+        }
+
+        int result = reserve_pages(node, entry->size);
+        if (result < 0) {
+            return result;
+        }
+
+        copy_file_data(node, 0, entry->size, (char*) header + entry->offset, true);
+        node->file_size = entry->size;
+    }
+
+    return ALL_OK;
+}
+
+// Directories on the way (e.g., "bin" in "bin/shell.elf") are created when missing. Return 0 if file exists already
+static struct ramfs_node* create_file_with_directories(struct ramfs_node* directory, const char* path) {
+    char name[RAMFS_NAME_LENGTH];
+
+    while (true) {
+        int length = 0;
+        while (*path != '/' && *path != 0x00) {
+            if (length == RAMFS_NAME_LENGTH - 1) {
+                return 0;
+            }
+            name[length++] = *path++;
+        }
+        name[length] = 0x00;
+
+        if (length == 0) {
+            return 0;
+        }
+
+        if (*path == 0x00) {
+            // same name twice in image
+            if (find_child(directory, name)) {
+                return 0;
+            }
+            return create_child(directory, name, false);
+        }
+        path++;
+
+        struct ramfs_node* child = find_child(directory, name);
+        if (!child) {
+            child = create_child(directory, name, true);
+        }
+
+        if (!child || !child->is_directory) {
+            return 0;
+        }
+        directory = child;
+    }
+}
+
+// Missing file is created unless opened for reading, write mode empties existing one
+void* ramfs_open(struct disk* disk, struct path_part* path, FILE_MODE mode) {
+    int error_code = 0;
+    struct ramfs_private_data* private_data = disk->filesystem_private_data;
+
+    struct path_part* last_part = 0;
+    struct ramfs_node* directory = get_parent_directory(&private_data->root_directory, path, &last_part);
+    if (!directory) {
+        error_code = -BAD_PATH_ERROR;
+        goto error_out;
+    }
+
+    struct ramfs_node* node = find_child(directory, last_part->part);
+    if (!node) {
+        if (mode == FILE_MODE_READ) {
+            error_code = -BAD_PATH_ERROR;
+            goto error_out;
+        }
+
+        node = create_child(directory, last_part->part, false);
+        if (!node) {
+            error_code = -NO_FREE_MEM_ERROR;
+            goto error_out;
+        }
+    }
+
+    if (node->is_directory) {
+        error_code = -INVALID_ARG_ERROR;
+        goto error_out;
+    }
+
+    struct ramfs_file_descriptor* descriptor = kzalloc(sizeof(struct ramfs_file_descriptor));
+    if (!descriptor) {
+        error_code = -NO_FREE_MEM_ERROR;
+        goto error_out;
+    }
+
+    descriptor->node = node;
+    descriptor->mode = mode;
+    if (mode == FILE_MODE_WRITE) {
+        truncate_node(node);
+    }
+
+    return descriptor;
+
+error_out:
+    return ERROR(error_code);
+}
+
+int ramfs_read(struct disk* disk, void* descriptor, uint32_t num_of_bytes, uint32_t num_of_blocks, char* out_ptr) {
+    struct ramfs_file_descriptor* ramfs_descriptor = descriptor;
+
+    int result = ramfs_read_at(disk, ramfs_descriptor, num_of_bytes * num_of_blocks, ramfs_descriptor->position, out_ptr);
+    if (result > 0) {
+        ramfs_descriptor->position += result;
+    }
+
+    return result;
+}
+
+// Pages are reserved first, so a failed write leaves file as it was. Append mode always writes from end of file
+int ramfs_write(struct disk* disk, void* descriptor, uint32_t num_of_bytes, uint32_t num_of_blocks, const char* in_ptr) {
+    int result = 0;
+    struct ramfs_file_descriptor* ramfs_descriptor = descriptor;
+    struct ramfs_node* node = ramfs_descriptor->node;
+
+    if (ramfs_descriptor->mode == FILE_MODE_READ) {
+        result = -READ_ONLY_ERROR;
+        goto out;
+    }
+
+    if (ramfs_descriptor->mode == FILE_MODE_APPEND) {
+        ramfs_descriptor->position = node->file_size;
+    }
+
+    if (num_of_blocks != 0 && num_of_bytes > FILE_MAX_TRANSFER_BYTES / num_of_blocks) {
+        result = -INVALID_ARG_ERROR;
+        goto out;
+    }
+
+    uint32_t total_bytes_to_write = num_of_bytes * num_of_blocks;
+    uint32_t end_position = ramfs_descriptor->position + total_bytes_to_write;
+    if (end_position < ramfs_descriptor->position) {
+        result = -INVALID_ARG_ERROR;
+        goto out;
+    }
+
+    result = reserve_pages(node, end_position);
+    if (result < 0) {
+        goto out;
+    }
+
+    copy_file_data(node, ramfs_descriptor->position, total_bytes_to_write, (void*) in_ptr, true);
+    ramfs_descriptor->position = end_position;
+    if (end_position > node->file_size) {
+        node->file_size = end_position;
+    }
+
+    result = total_bytes_to_write;
+out:
+    return result;
+}
+
+// Read at most up to end of file, file position is left untouched
+int ramfs_read_at(struct disk* disk, void* descriptor, uint32_t num_of_bytes, FILE_POSITION position, char* out_ptr) {
+    struct ramfs_file_descriptor* ramfs_descriptor = descriptor;
+    struct ramfs_node* node = ramfs_descriptor->node;
+
+    if (position >= node->file_size) {
+        return 0;
+    }
+
+    uint32_t total_bytes_to_read = node->file_size - position;
+    if (total_bytes_to_read > num_of_bytes) {
+        total_bytes_to_read = num_of_bytes;
+    }
+
+    copy_file_data(node, position, total_bytes_to_read, out_ptr, false);
+    return total_bytes_to_read;
+}
+
+// Position can be anywhere from beginning to end of file, end of file included
+int ramfs_seek(void* private_descriptor, FILE_OFFSET offset, FILE_SEEK_MODE seek_mode) {
+    int result = 0;
+    struct ramfs_file_descriptor* descriptor = private_descriptor;
+
+    FILE_OFFSET base = 0;
+    switch (seek_mode) {
+        case SEEK_SET:
+            base = 0;
+            break;
+
+        case SEEK_CURRENT:
+            base = descriptor->position;
+            break;
+
+        case SEEK_END:
+            base = descriptor->node->file_size;
+            break;
+
+        default:
+            result = -INVALID_ARG_ERROR;
+            goto out;
+    }
+
+    FILE_OFFSET new_position = base + offset;
+    if (new_position < 0 || new_position > descriptor->node->file_size) {
+        result = -INVALID_ARG_ERROR;
+        goto out;
+    }
+
+    descriptor->position = new_position;
+out:
+    return result;
+}
+
+int ramfs_stat(struct disk* disk, void* private, struct file_stat* stat) {
+    struct ramfs_file_descriptor* descriptor = private;
+    stat->file_size = descriptor->node->file_size;
+    stat->flags = 0x00;
+    return ALL_OK;
+}
+
+int ramfs_close(void* private_data) {
+    kfree(private_data);
+    return ALL_OK;
+}
+
+// path is null for root directory
+void* ramfs_open_directory(struct disk* disk, struct path_part* path) {
+    int error_code = 0;
+    struct ramfs_private_data* private_data = disk->filesystem_private_data;
+
+    struct ramfs_node* directory = &private_data->root_directory;
+    for (struct path_part* part = path; part; part = part->next) {
+        directory = find_child(directory, part->part);
+        if (!directory || !directory->is_directory) {
+            error_code = -BAD_PATH_ERROR;
+            goto error_out;
+        }
+    }
+
+    struct ramfs_directory_descriptor* descriptor = kzalloc(sizeof(struct ramfs_directory_descriptor));
+    if (!descriptor) {
+        error_code = -NO_FREE_MEM_ERROR;
+        goto error_out;
+    }
+
+    descriptor->next_child = directory->first_child;
+    return descriptor;
+
+error_out:
+    return ERROR(error_code);
+}
+
+int ramfs_read_directory(struct disk* disk, void* private_data, struct directory_entry* out, uint32_t size) {
+    struct ramfs_directory_descriptor* descriptor = private_data;
+    uint32_t total_bytes = 0;
+
+    while (descriptor->next_child) {
+        struct ramfs_node* node = descriptor->next_child;
+
+        // keep every entry 4 bytes aligned
+        uint32_t record_length = (sizeof(struct directory_entry) + strlen(node->name) + 1 + 3) & ~3;
+        if (total_bytes + record_length > size) {
+            break;
+        }
+
+        struct directory_entry* entry = (struct directory_entry*) ((char*) out + total_bytes);
+        entry->record_length = record_length;
+        entry->flags = node->is_directory ? FILE_STAT_DIRECTORY : 0x00;
+        entry->file_size = node->file_size;
+        strcpy(entry->name, node->name);
+
+        total_bytes += record_length;
+        descriptor->next_child = node->next_sibling;
+    }
+
+    // entry which can never fit would stop listing forever
+    if (total_bytes == 0 && descriptor->next_child) {
+        return -INVALID_ARG_ERROR;
+    }
+
+    return total_bytes;
+}
+
+int ramfs_close_directory(void* private_data) {
+    kfree(private_data);
+    return ALL_OK;
+}
+
+// VFS makes sure no file or directory is still open, so every node can go
+int ramfs_unmount(struct disk* disk) {
+    struct ramfs_private_data* private_data = disk->filesystem_private_data;
+    free_node(&private_data->root_directory);
+    kfree(private_data);
+    disk->filesystem_private_data = 0;
+    return ALL_OK;
+}
+
+static struct ramfs_node* find_child(struct ramfs_node* directory, const char* name) {
+    for (struct ramfs_node* child = directory->first_child; child; child = child->next_sibling) {
+        if (strcmp(child->name, name, RAMFS_NAME_LENGTH) == 0) {
+            return child;
+        }
+    }
+
+    return 0;
+}
+
+// new node goes last, so directory lists in creation order
+static struct ramfs_node* create_child(struct ramfs_node* directory, const char* name, bool is_directory) {
+    if (strlen_max(name, RAMFS_NAME_LENGTH) >= RAMFS_NAME_LENGTH) {
+        return 0;
+    }
+
+    struct ramfs_node* node = kzalloc(sizeof(struct ramfs_node));
+    if (!node) {
+        return 0;
+    }
+
+    strcpy_max_length(node->name, name, sizeof(node->name));
+    node->is_directory = is_directory;
+
+    struct ramfs_node** link = &directory->first_child;
+    while (*link) {
+        link = &(*link)->next_sibling;
+    }
+    *link = node;
+
+    return node;
+}
+
+// Walk every part but the last, which is returned through last_part
+static struct ramfs_node* get_parent_directory(struct ramfs_node* root_directory, struct path_part* path, struct path_part** last_part) {
+    struct ramfs_node* directory = root_directory;
+    struct path_part* current_part = path;
+
+    while (current_part->next) {
+        directory = find_child(directory, current_part->part);
+        if (!directory || !directory->is_directory) {
+            return 0;
+        }
+
+        current_part = current_part->next;
+    }
+
+    *last_part = current_part;
+    return directory;
+}
+
+// Make sure pages backing the first size bytes exist. New pages are zeroed
+static int reserve_pages(struct ramfs_node* node, uint32_t size) {
+    uint32_t total_pages = size / RAMFS_PAGE_SIZE + (size % RAMFS_PAGE_SIZE != 0);
+
+    if (total_pages > node->pages_capacity) {
+        // heap hands out whole blocks anyway, so page array grows a block at a time at least
+        uint32_t pointers_per_block = RAMFS_PAGE_SIZE / sizeof(void*);
+        uint32_t new_capacity = node->pages_capacity * 2;
+        if (new_capacity < total_pages) {
+            new_capacity = total_pages;
+        }
+        new_capacity = (new_capacity + pointers_per_block - 1) / pointers_per_block * pointers_per_block;
+
+        void** new_pages = kzalloc(new_capacity * sizeof(void*));
+        if (!new_pages) {
+            return -NO_FREE_MEM_ERROR;
+        }
+
+        if (node->pages) {
+            memcpy(new_pages, node->pages, node->total_pages * sizeof(void*));
+            kfree(node->pages);
+        }
+        node->pages = new_pages;
+        node->pages_capacity = new_capacity;
+    }
+
+    // pages allocated before failure are kept, next write reuses them
+    while (node->total_pages < total_pages) {
+        void* page = kzalloc(RAMFS_PAGE_SIZE);
+        if (!page) {
+            return -NO_FREE_MEM_ERROR;
+        }
+
+        node->pages[node->total_pages++] = page;
+    }
+
+    return ALL_OK;
+}
+
+// copy page by page, pages backing the range must exist
+static void copy_file_data(struct ramfs_node* node, FILE_POSITION position, uint32_t total_bytes, void* buffer, bool write) {
+    uint32_t total_copied = 0;
+    while (total_copied < total_bytes) {
+        uint32_t page_index = (position + total_copied) / RAMFS_PAGE_SIZE;
+        uint32_t page_offset = (position + total_copied) % RAMFS_PAGE_SIZE;
+        uint32_t total_bytes_in_page = RAMFS_PAGE_SIZE - page_offset;
+        if (total_bytes_in_page > total_bytes - total_copied) {
+            total_bytes_in_page = total_bytes - total_copied;
+        }
+
+        char* page_data = (char*) node->pages[page_index] + page_offset;
+        char* buffer_data = (char*) buffer + total_copied;
+        if (write) {
+            memcpy(page_data, buffer_data, total_bytes_in_page);
+        } else {
+            memcpy(buffer_data, page_data, total_bytes_in_page);
+        }
+
+        total_copied += total_bytes_in_page;
+    }
+}
+
+// drop file content, node itself stays
+static void truncate_node(struct ramfs_node* node) {
+    for (uint32_t i = 0; i < node->total_pages; i++) {
+        kfree(node->pages[i]);
+    }
+
+    if (node->pages) {
+        kfree(node->pages);
+    }
+
+    node->pages = 0;
+    node->total_pages = 0;
+    node->pages_capacity = 0;
+    node->file_size = 0;
+}
+
+// free content and every node under it, node itself belongs to caller
+static void free_node(struct ramfs_node* node) {
+    struct ramfs_node* child = node->first_child;
+    while (child) {
+        struct ramfs_node* next_child = child->next_sibling;
+        free_node(child);
+        kfree(child);
+        child = next_child;
+    }
+
+    node->first_child = 0;
+    truncate_node(node);
+}
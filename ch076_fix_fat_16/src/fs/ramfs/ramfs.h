@@ -0,0 +1,9 @@
+#ifndef RAMFS_H
+#define RAMFS_H
+
+#include "file.h"
+
+// in-memory filesystem, resolved on memory disks
+struct filesystem* initialize_ramfs_filesystem();
+
+#endif
@@ -6,6 +6,7 @@
 #include "task/task.h"
 #include "status.h"
 #include "task/process.h"
+#include "disk/disk_cache.h"
 
 struct idt_desc idt_descriptor_array[TOTAL_INTERRUPTS];
 struct idtr_desc idtr_descriptor;
@@ -65,6 +66,7 @@ void idt_zero() {
 
 void idt_clock() {
     outb(0x20, 0x20); // just ack
+    handle_disk_cache_timer_tick();
     run_next_task();
 }
 
@@ -87,6 +89,8 @@ void* isr80h_handler(int system_call_code, struct interrupt_frame* interrupt_fra
     save_current_task_state(interrupt_frame);
 
     result = handle_system_calls_for_isr80h(system_call_code, interrupt_frame);
+    // periodic flush requested by timer interrupt
+    run_pending_disk_cache_flush();
     load_task_page();
 
     return result;
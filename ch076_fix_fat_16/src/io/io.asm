@@ -2,8 +2,10 @@ section .asm
 
 global insb
 global insw
+global insdw
 global outb
 global outw
+global outdw
 
 ; IN instruction
 ; https://c9x.me/x86/html/file_module_x86_id_139.html
@@ -30,6 +32,17 @@ insw:
     pop ebp
     ret ; return EAX
 
+insdw:
+    push ebp
+    mov ebp, esp
+
+    xor eax, eax ; eax stores return value. XOR itself makes it 0(clear it)
+    mov edx, [ebp+8] ; port is parameter. Then store that in edx
+    in eax, dx ; Read from port specified in DX(lower 16 bit in EDX) to EAX(32 bit[double word]).
+
+    pop ebp
+    ret ; return EAX
+
 ; https://www.felixcloutier.com/x86/out
 outb:
     push ebp
@@ -50,5 +63,16 @@ outw:
     mov edx, [ebp+8] ; edx stores "port"
     out dx, ax ; output value in ax (lower 16 bit[word] of eax) to port specified in DX(lower 16 bit of EDX)
 
+    pop ebp
+    ret
+
+outdw:
+    push ebp
+    mov ebp, esp
+
+    mov eax, [ebp+12] ; eax stores "val"
+    mov edx, [ebp+8] ; edx stores "port"
+    out dx, eax ; output value in eax (32 bit[double word]) to port specified in DX(lower 16 bit of EDX)
+
     pop ebp
     ret
\ No newline at end of file
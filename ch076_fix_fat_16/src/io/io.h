@@ -3,8 +3,10 @@
 
 unsigned char insb(unsigned short port);
 unsigned short insw(unsigned short port);
+unsigned int insdw(unsigned short port);
 
 void outb(unsigned short port, unsigned char val);
 void outw(unsigned short port, unsigned short val);
+void outdw(unsigned short port, unsigned int val);
 
 #endif
\ No newline at end of file
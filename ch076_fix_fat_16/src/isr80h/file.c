@@ -0,0 +1,197 @@
+#include "file.h"
+#include "fs/file.h"
+#include "task/task.h"
+#include "task/process.h"
+#include "config.h"
+#include "status.h"
+#include "string/string.h"
+#include "disk/disk.h"
+#include "kernel.h"
+
+static void get_path_on_drive(const char* user_path, char* out, int max_length);
+
+// write all cached disk writes back
+void* system_call_10_sync(struct interrupt_frame* interrupt_frame) {
+    return (void*) sync();
+}
+
+// path is relative to drive 0 unless it names a drive (e.g., 9:/), "" opens root directory. Return directory descriptor, 0 on failure
+void* system_call_11_open_directory(struct interrupt_frame* interrupt_frame) {
+    void* path_user_ptr = get_task_stack_item(get_current_task(), 0);
+    char relative_path[MAX_PATH];
+    int result = copy_string_from_task(get_current_task(), path_user_ptr, relative_path, sizeof(relative_path));
+    if (result < 0) {
+        return 0;
+    }
+
+    char path[MAX_PATH];
+    get_path_on_drive(relative_path, path, sizeof(path));
+
+    return (void*) opendir(&get_current_task()->process->file_table, path);
+}
+
+// Entries are written straight into user buffer, as many as fit. Return bytes written, 0 once every entry was read
+void* system_call_12_read_directory(struct interrupt_frame* interrupt_frame) {
+    struct task* task = get_current_task();
+    int directory_descriptor = (int) get_task_stack_item(task, 0);
+    void* buffer_user_ptr = get_task_stack_item(task, 1);
+    uint32_t size = (uint32_t) get_task_stack_item(task, 2);
+
+    struct directory_entry* out = get_task_writable_buffer(task, buffer_user_ptr, size);
+    if (!out) {
+        return ERROR(-INVALID_ARG_ERROR);
+    }
+
+    return (void*) readdir(&task->process->file_table, directory_descriptor, out, size);
+}
+
+void* system_call_13_close_directory(struct interrupt_frame* interrupt_frame) {
+    int directory_descriptor = (int) get_task_stack_item(get_current_task(), 0);
+    return (void*) closedir(&get_current_task()->process->file_table, directory_descriptor);
+}
+
+// path is relative to drive 0 unless it names a drive, mode is "r", "w" or "a". Return file descriptor, 0 on failure
+void* system_call_14_open(struct interrupt_frame* interrupt_frame) {
+    struct task* task = get_current_task();
+    char relative_path[MAX_PATH];
+    int result = copy_string_from_task(task, get_task_stack_item(task, 0), relative_path, sizeof(relative_path));
+    if (result < 0) {
+        return 0;
+    }
+
+    char mode[4];
+    result = copy_string_from_task(task, get_task_stack_item(task, 1), mode, sizeof(mode));
+    if (result < 0) {
+        return 0;
+    }
+
+    char path[MAX_PATH];
+    get_path_on_drive(relative_path, path, sizeof(path));
+
+    return (void*) fopen(&task->process->file_table, path, mode);
+}
+
+// File data goes straight into user buffer, one read per physically continuous piece of it.
+// Return bytes read, less than size at end of file
+void* system_call_15_read(struct interrupt_frame* interrupt_frame) {
+    struct task* task = get_current_task();
+    int file_descriptor = (int) get_task_stack_item(task, 0);
+    char* buffer_user_ptr = get_task_stack_item(task, 1);
+    uint32_t size = (uint32_t) get_task_stack_item(task, 2);
+
+    int total_read = 0;
+    while (size > 0) {
+        uint32_t chunk_size = 0;
+        void* out = get_task_writable_chunk(task, buffer_user_ptr, size, &chunk_size);
+        if (!out) {
+            // whatever was read already stays valid
+            return total_read ? (void*) total_read : ERROR(-INVALID_ARG_ERROR);
+        }
+
+        int result = fread(&task->process->file_table, out, chunk_size, 1, file_descriptor);
+        if (result < 0) {
+            return total_read ? (void*) total_read : ERROR(result);
+        }
+
+        total_read += result;
+        // end of file
+        if ((uint32_t) result < chunk_size) {
+            break;
+        }
+
+        buffer_user_ptr += chunk_size;
+        size -= chunk_size;
+    }
+
+    return (void*) total_read;
+}
+
+// offset is signed, whence is SEEK_SET, SEEK_CURRENT or SEEK_END
+void* system_call_16_seek(struct interrupt_frame* interrupt_frame) {
+    struct task* task = get_current_task();
+    int file_descriptor = (int) get_task_stack_item(task, 0);
+    int offset = (int) get_task_stack_item(task, 1);
+    FILE_SEEK_MODE whence = (FILE_SEEK_MODE) get_task_stack_item(task, 2);
+
+    return (void*) fseek(&task->process->file_table, file_descriptor, offset, whence);
+}
+
+void* system_call_17_stat(struct interrupt_frame* interrupt_frame) {
+    struct task* task = get_current_task();
+    int file_descriptor = (int) get_task_stack_item(task, 0);
+    struct file_stat* out = get_task_writable_buffer(task, get_task_stack_item(task, 1), sizeof(struct file_stat));
+    if (!out) {
+        return ERROR(-INVALID_ARG_ERROR);
+    }
+
+    return (void*) fstat(&task->process->file_table, file_descriptor, out);
+}
+
+void* system_call_18_close(struct interrupt_frame* interrupt_frame) {
+    int file_descriptor = (int) get_task_stack_item(get_current_task(), 0);
+    return (void*) fclose(&get_current_task()->process->file_table, file_descriptor);
+}
+
+// mount filesystem of disk with given ID on drive_num, so it's reachable through "${drive_num}:/" paths
+void* system_call_19_mount(struct interrupt_frame* interrupt_frame) {
+    struct task* task = get_current_task();
+    int drive_num = (int) get_task_stack_item(task, 0);
+    int disk_id = (int) get_task_stack_item(task, 1);
+
+    struct disk* disk = get_disk(disk_id);
+    if (!disk) {
+        return ERROR(-INVALID_ARG_ERROR);
+    }
+
+    return (void*) mount_disk(drive_num, disk);
+}
+
+// fails while anything is still open on the drive
+void* system_call_20_unmount(struct interrupt_frame* interrupt_frame) {
+    int drive_num = (int) get_task_stack_item(get_current_task(), 0);
+    return (void*) unmount_disk(drive_num);
+}
+
+// File data is taken straight from user buffer, one write per physically continuous piece of it. Return bytes written
+void* system_call_21_write(struct interrupt_frame* interrupt_frame) {
+    struct task* task = get_current_task();
+    int file_descriptor = (int) get_task_stack_item(task, 0);
+    char* buffer_user_ptr = get_task_stack_item(task, 1);
+    uint32_t size = (uint32_t) get_task_stack_item(task, 2);
+
+    int total_written = 0;
+    while (size > 0) {
+        uint32_t chunk_size = 0;
+        void* in = get_task_readable_chunk(task, buffer_user_ptr, size, &chunk_size);
+        if (!in) {
+            return total_written ? (void*) total_written : ERROR(-INVALID_ARG_ERROR);
+        }
+
+        int result = fwrite(&task->process->file_table, in, chunk_size, 1, file_descriptor);
+        if (result < 0) {
+            return total_written ? (void*) total_written : ERROR(result);
+        }
+
+        total_written += result;
+        buffer_user_ptr += result;
+        size -= result;
+
+        // filesystem stopped early, rest of the buffer would land at wrong position
+        if (result < chunk_size) {
+            break;
+        }
+    }
+
+    return (void*) total_written;
+}
+
+// Path with drive prefix (e.g., 9:/tmp.txt) is kept as it is, other paths are under drive 0
+static void get_path_on_drive(const char* user_path, char* out, int max_length) {
+    if (is_digit(user_path[0]) && user_path[1] == ':' && user_path[2] == '/') {
+        strcpy_max_length(out, user_path, max_length);
+        return;
+    }
+
+    strcpy(out, "0:/");
+    strcpy_max_length(out + 3, user_path, max_length - 3); // 3 bytes for '0', ':', '/'
+}
@@ -0,0 +1,19 @@
+#ifndef ISR80H_FILE_H
+#define ISR80H_FILE_H
+
+struct interrupt_frame;
+
+void* system_call_10_sync(struct interrupt_frame* interrupt_frame);
+void* system_call_11_open_directory(struct interrupt_frame* interrupt_frame);
+void* system_call_12_read_directory(struct interrupt_frame* interrupt_frame);
+void* system_call_13_close_directory(struct interrupt_frame* interrupt_frame);
+void* system_call_14_open(struct interrupt_frame* interrupt_frame);
+void* system_call_15_read(struct interrupt_frame* interrupt_frame);
+void* system_call_16_seek(struct interrupt_frame* interrupt_frame);
+void* system_call_17_stat(struct interrupt_frame* interrupt_frame);
+void* system_call_18_close(struct interrupt_frame* interrupt_frame);
+void* system_call_19_mount(struct interrupt_frame* interrupt_frame);
+void* system_call_20_unmount(struct interrupt_frame* interrupt_frame);
+void* system_call_21_write(struct interrupt_frame* interrupt_frame);
+
+#endif
@@ -4,6 +4,7 @@
 #include "io.h"
 #include "heap.h"
 #include "process.h"
+#include "file.h"
 
 void register_system_calls() {
     register_system_call(SYSTEM_CALL_SUM, system_call_0_sum);
@@ -16,4 +17,16 @@ void register_system_calls() {
     register_system_call(SYSTEM_CALL_INVOKE_SYSTEM_COMMAND, system_call_7_invoke_system_command);
     register_system_call(SYSTEM_CALL_GET_PROGRAM_ARGUMENTS, system_call_8_get_program_arguments);
     register_system_call(SYSTEM_CALL_EXIT, system_call_9_exit);
+    register_system_call(SYSTEM_CALL_SYNC, system_call_10_sync);
+    register_system_call(SYSTEM_CALL_OPEN_DIRECTORY, system_call_11_open_directory);
+    register_system_call(SYSTEM_CALL_READ_DIRECTORY, system_call_12_read_directory);
+    register_system_call(SYSTEM_CALL_CLOSE_DIRECTORY, system_call_13_close_directory);
+    register_system_call(SYSTEM_CALL_OPEN, system_call_14_open);
+    register_system_call(SYSTEM_CALL_READ, system_call_15_read);
+    register_system_call(SYSTEM_CALL_SEEK, system_call_16_seek);
+    register_system_call(SYSTEM_CALL_STAT, system_call_17_stat);
+    register_system_call(SYSTEM_CALL_CLOSE, system_call_18_close);
+    register_system_call(SYSTEM_CALL_MOUNT, system_call_19_mount);
+    register_system_call(SYSTEM_CALL_UNMOUNT, system_call_20_unmount);
+    register_system_call(SYSTEM_CALL_WRITE, system_call_21_write);
 }
@@ -11,7 +11,19 @@ enum system_calls {
     SYSTEM_CALL_START_LOAD_PROCESS,
     SYSTEM_CALL_INVOKE_SYSTEM_COMMAND,
     SYSTEM_CALL_GET_PROGRAM_ARGUMENTS,
-    SYSTEM_CALL_EXIT
+    SYSTEM_CALL_EXIT,
+    SYSTEM_CALL_SYNC,
+    SYSTEM_CALL_OPEN_DIRECTORY,
+    SYSTEM_CALL_READ_DIRECTORY,
+    SYSTEM_CALL_CLOSE_DIRECTORY,
+    SYSTEM_CALL_OPEN,
+    SYSTEM_CALL_READ,
+    SYSTEM_CALL_SEEK,
+    SYSTEM_CALL_STAT,
+    SYSTEM_CALL_CLOSE,
+    SYSTEM_CALL_MOUNT,
+    SYSTEM_CALL_UNMOUNT,
+    SYSTEM_CALL_WRITE
 };
 
 void register_system_calls();
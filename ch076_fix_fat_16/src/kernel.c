@@ -89,7 +89,7 @@ void kernel_main() {
 
     struct process* process = 0;
 
-    // run process 1
+    // run process 1. Drive 0 is initramfs when boot image has one, so programs start from memory
     int result = load_and_switch_process("0:/blank.elf", &process);
     if (result != ALL_OK) {
         panic("Failed to load shell.elf\n");
@@ -112,7 +112,7 @@ int load_elf_file(const char* filename, struct elf_file** loaded_elf) {
     struct elf_file* elf_file = kzalloc(sizeof(struct elf_file));
 
     int fd = 0;
-    int result = fopen(filename, "r");
+    int result = fopen(get_kernel_file_table(), filename, "r");
 
     if (result <= 0) {
         result = -IO_ERROR;
@@ -121,19 +121,24 @@ int load_elf_file(const char* filename, struct elf_file** loaded_elf) {
     fd = result;
 
     struct file_stat file_state;
-    result = fstat(fd, &file_state);
+    result = fstat(get_kernel_file_table(), fd, &file_state);
 
     if (result < 0) {
         goto out;
     }
 
     elf_file -> elf_memory = kzalloc(file_state.file_size);
-    result = fread(elf_file->elf_memory, file_state.file_size, 1, fd);
+    result = fread(get_kernel_file_table(), elf_file->elf_memory, file_state.file_size, 1, fd);
 
     if (result < 0) {
         goto out;
     }
 
+    if (result != file_state.file_size) {
+        result = -IO_ERROR;
+        goto out;
+    }
+
     result = load_process_from_elf(elf_file);
     if (result < 0) {
         goto out;
@@ -142,7 +147,7 @@ int load_elf_file(const char* filename, struct elf_file** loaded_elf) {
     *loaded_elf = elf_file;
 
 out:
-    fclose(fd);
+    fclose(get_kernel_file_table(), fd);
     return result;
 }
 
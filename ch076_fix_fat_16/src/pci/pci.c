@@ -0,0 +1,99 @@
+#include "pci.h"
+#include "io/io.h"
+#include "status.h"
+
+static uint32_t create_pci_config_address(uint8_t bus, uint8_t slot, uint8_t function, uint8_t offset);
+static void load_pci_device(uint8_t bus, uint8_t slot, uint8_t function, struct pci_device* device);
+
+// Configuration address layout
+// bit 31     -> enable bit
+// bit 23-16  -> bus number
+// bit 15-11  -> device(slot) number
+// bit 10-8   -> function number
+// bit 7-0    -> register offset, always 4 bytes aligned
+static uint32_t create_pci_config_address(uint8_t bus, uint8_t slot, uint8_t function, uint8_t offset) {
+    return (uint32_t)(
+        (1 << 31) |
+        ((uint32_t) bus << 16) |
+        ((uint32_t) (slot & 0x1F) << 11) |
+        ((uint32_t) (function & 0x07) << 8) |
+        (offset & 0xFC)
+    );
+}
+
+uint32_t read_pci_config(uint8_t bus, uint8_t slot, uint8_t function, uint8_t offset) {
+    outdw(PCI_CONFIG_ADDRESS_PORT, create_pci_config_address(bus, slot, function, offset));
+    return insdw(PCI_CONFIG_DATA_PORT);
+}
+
+void write_pci_config(uint8_t bus, uint8_t slot, uint8_t function, uint8_t offset, uint32_t value) {
+    outdw(PCI_CONFIG_ADDRESS_PORT, create_pci_config_address(bus, slot, function, offset));
+    outdw(PCI_CONFIG_DATA_PORT, value);
+}
+
+// Brute force scan all bus/slot/function combinations.
+// "skip" is the number of matched devices to ignore, so caller can iterate multiple controllers of the same class
+int find_pci_device_by_class(uint8_t class_code, uint8_t subclass, uint8_t prog_if, int skip, struct pci_device* device) {
+    for (int bus = 0; bus < PCI_TOTAL_BUSES; bus++) {
+        for (int slot = 0; slot < PCI_TOTAL_SLOTS; slot++) {
+            for (int function = 0; function < PCI_TOTAL_FUNCTIONS; function++) {
+                uint32_t id = read_pci_config(bus, slot, function, PCI_VENDOR_ID_OFFSET);
+                if ((id & 0xFFFF) == PCI_NO_DEVICE) {
+                    // no function 0 means no device in the slot at all
+                    if (function == 0) {
+                        break;
+                    }
+                    continue;
+                }
+
+                uint32_t class_register = read_pci_config(bus, slot, function, PCI_CLASS_OFFSET);
+                uint8_t current_class_code = (class_register >> 24) & 0xFF;
+                uint8_t current_subclass = (class_register >> 16) & 0xFF;
+                uint8_t current_prog_if = (class_register >> 8) & 0xFF;
+
+                if (current_class_code == class_code && current_subclass == subclass && current_prog_if == prog_if) {
+                    if (skip == 0) {
+                        load_pci_device(bus, slot, function, device);
+                        return ALL_OK;
+                    }
+                    skip--;
+                }
+
+                // single function device only implements function 0
+                uint32_t header_type = (read_pci_config(bus, slot, 0, PCI_HEADER_TYPE_OFFSET) >> 16) & 0xFF;
+                if (function == 0 && !(header_type & 0x80)) {
+                    break;
+                }
+            }
+        }
+    }
+
+    return -IO_ERROR;
+}
+
+static void load_pci_device(uint8_t bus, uint8_t slot, uint8_t function, struct pci_device* device) {
+    uint32_t id = read_pci_config(bus, slot, function, PCI_VENDOR_ID_OFFSET);
+    uint32_t class_register = read_pci_config(bus, slot, function, PCI_CLASS_OFFSET);
+
+    device->bus = bus;
+    device->slot = slot;
+    device->function = function;
+    device->vendor_id = id & 0xFFFF;
+    device->device_id = (id >> 16) & 0xFFFF;
+    device->class_code = (class_register >> 24) & 0xFF;
+    device->subclass = (class_register >> 16) & 0xFF;
+    device->prog_if = (class_register >> 8) & 0xFF;
+}
+
+// Only memory mapped 32 bit BAR is handled. Lowest 4 bits are flags, not part of address
+uint32_t get_pci_bar(struct pci_device* device, int bar_index) {
+    uint32_t bar = read_pci_config(device->bus, device->slot, device->function, PCI_BAR0_OFFSET + (bar_index * 4));
+    return bar & 0xFFFFFFF0;
+}
+
+// Device can only do DMA(write to/read from memory by itself) once bus mastering enabled
+void enable_pci_bus_mastering(struct pci_device* device) {
+    uint32_t command = read_pci_config(device->bus, device->slot, device->function, PCI_COMMAND_OFFSET);
+    command |= PCI_COMMAND_MEMORY_SPACE | PCI_COMMAND_BUS_MASTER;
+    write_pci_config(device->bus, device->slot, device->function, PCI_COMMAND_OFFSET, command);
+}
@@ -0,0 +1,46 @@
+#ifndef PCI_H
+#define PCI_H
+
+#include <stdint.h>
+
+// https://wiki.osdev.org/PCI#Configuration_Space_Access_Mechanism_.231
+#define PCI_CONFIG_ADDRESS_PORT 0xCF8
+#define PCI_CONFIG_DATA_PORT 0xCFC
+
+#define PCI_TOTAL_BUSES 256
+#define PCI_TOTAL_SLOTS 32
+#define PCI_TOTAL_FUNCTIONS 8
+
+// offsets in configuration space header
+#define PCI_VENDOR_ID_OFFSET 0x00
+#define PCI_COMMAND_OFFSET 0x04
+#define PCI_CLASS_OFFSET 0x08
+#define PCI_HEADER_TYPE_OFFSET 0x0C
+#define PCI_BAR0_OFFSET 0x10
+
+#define PCI_NO_DEVICE 0xFFFF
+
+// command register bits
+#define PCI_COMMAND_MEMORY_SPACE 0x0002
+#define PCI_COMMAND_BUS_MASTER 0x0004
+
+struct pci_device {
+    uint8_t bus;
+    uint8_t slot;
+    uint8_t function;
+
+    uint16_t vendor_id;
+    uint16_t device_id;
+
+    uint8_t class_code;
+    uint8_t subclass;
+    uint8_t prog_if;
+};
+
+uint32_t read_pci_config(uint8_t bus, uint8_t slot, uint8_t function, uint8_t offset);
+void write_pci_config(uint8_t bus, uint8_t slot, uint8_t function, uint8_t offset, uint32_t value);
+int find_pci_device_by_class(uint8_t class_code, uint8_t subclass, uint8_t prog_if, int skip, struct pci_device* device);
+uint32_t get_pci_bar(struct pci_device* device, int bar_index);
+void enable_pci_bus_mastering(struct pci_device* device);
+
+#endif
@@ -11,5 +11,6 @@
 #define UNIMPLEMENTED_ERROR 7
 #define IS_TAKEN_ERROR 8
 #define INVALID_FORMAT_ERROR 9
+#define NO_FREE_SPACE_ERROR 10
 
 #endif
\ No newline at end of file
@@ -109,5 +109,13 @@ char tolower(char str) {
         str += 32;
     }
 
+    return str;
+}
+
+char toupper(char str) {
+    if (str >= 97 && str <= 122) {
+        str -= 32;
+    }
+
     return str;
 }
\ No newline at end of file
@@ -12,5 +12,6 @@ char* strcpy_max_length(char* dest, const char* src, int max_length);
 bool is_digit(char c);
 int to_numeric_digit(char c);
 char tolower(char str);
+char toupper(char str);
 
 #endif
\ No newline at end of file
@@ -180,14 +180,14 @@ static int load_binary(const char* filename, struct process* process) {
     int result = 0;
     void* program_data_pointer = 0x00;
 
-    int file_descriptor = fopen(filename, "r");
+    int file_descriptor = fopen(get_kernel_file_table(), filename, "r");
     if (!file_descriptor) {
         result = -IO_ERROR;
         goto out;
     }
 
     struct file_stat stat;
-    result = fstat(file_descriptor, &stat);
+    result = fstat(get_kernel_file_table(), file_descriptor, &stat);
     if (result != ALL_OK) {
         goto out;
     }
@@ -199,8 +199,8 @@ static int load_binary(const char* filename, struct process* process) {
         goto out;
     }
 
-    // read file_size * 1 blocks = [file size] blocs
-    if (fread(program_data_pointer, stat.file_size, 1, file_descriptor) != 1) {
+    // read returns bytes read, short read means file changed or disk failed
+    if (fread(get_kernel_file_table(), program_data_pointer, stat.file_size, 1, file_descriptor) != stat.file_size) {
         result = -IO_ERROR;
         goto out;
     }
@@ -215,7 +215,7 @@ out:
             kfree(program_data_pointer);
         }
     }
-    fclose(file_descriptor);
+    fclose(get_kernel_file_table(), file_descriptor);
     return result;
 }
 
@@ -475,6 +475,9 @@ int count_command_arguments(struct command_argument* root_argument) {
 int terminate_process(struct process* process) {
     int result = 0;
 
+    // close everything process left opened
+    close_file_table(&process->file_table);
+
     // free pages
     result = terminate_process_allocations(process);
     if (result < 0) {
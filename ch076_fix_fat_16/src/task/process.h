@@ -5,6 +5,7 @@
 #include <stdbool.h>
 #include "config.h"
 #include "task.h"
+#include "fs/file.h"
 
 #define PROCESS_FILE_TYPE_ELF 0
 #define PROCESS_FILE_TYPE_BINARY 1
@@ -64,6 +65,9 @@ struct process {
 
     // process argument
     struct process_arguments arguments;
+
+    // files and directories opened by the process, closed when it exits
+    struct file_table file_table;
 };
 
 int load_process_into_slot(const char* filename, struct process** process, int process_slot);
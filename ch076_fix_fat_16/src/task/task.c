@@ -18,6 +18,7 @@ struct task* task_head = 0;
 
 int initialize_task(struct task* task, struct process* process);
 static void remove_task_from_list(struct task* task);
+static void* get_task_chunk(struct task* task, void* virtual_address, uint32_t size, uint32_t required_flags, uint32_t* chunk_size);
 
 
 struct task* get_current_task() {
@@ -227,6 +228,68 @@ void* convert_virtual_address_to_physical(struct task* task, void* virtual_addre
     return get_physical_address(task->page_directory->directory_entry, virtual_address);
 }
 
+// Task memory is mapped from kernel heap in one piece, so kernel can fill a task buffer directly through its physical address,
+// without copying through a temporary page. Return 0 unless every page of the buffer is writable by the task and physically continuous
+void* get_task_writable_buffer(struct task* task, void* virtual_address, uint32_t size) {
+    uint32_t chunk_size = 0;
+    void* buffer = get_task_writable_chunk(task, virtual_address, size, &chunk_size);
+    if (chunk_size != size) {
+        return 0;
+    }
+
+    return buffer;
+}
+
+// Same as get_task_writable_buffer, but buffer may be spread over separate physical pieces.
+// Return physical address of the first piece and its size through chunk_size, 0 if even first page isn't writable
+void* get_task_writable_chunk(struct task* task, void* virtual_address, uint32_t size, uint32_t* chunk_size) {
+    return get_task_chunk(task, virtual_address, size, PAGING_IS_PRESENT | PAGING_IS_WRITABLE | PAGING_ACCESS_FROM_ALL, chunk_size);
+}
+
+// For buffers kernel only reads from, e.g. data to write to a file. Read only pages like .rodata are fine
+void* get_task_readable_chunk(struct task* task, void* virtual_address, uint32_t size, uint32_t* chunk_size) {
+    return get_task_chunk(task, virtual_address, size, PAGING_IS_PRESENT | PAGING_ACCESS_FROM_ALL, chunk_size);
+}
+
+// Leading physically continuous piece of the buffer whose pages all have required_flags
+static void* get_task_chunk(struct task* task, void* virtual_address, uint32_t size, uint32_t required_flags, uint32_t* chunk_size) {
+    *chunk_size = 0;
+    uint32_t start = (uint32_t) virtual_address;
+    if (size == 0 || start + size < start) {
+        return 0;
+    }
+
+    uint32_t* task_directory = task->page_directory->directory_entry;
+    uint32_t first_page = (uint32_t) align_paging_to_lower_page(virtual_address);
+    uint32_t first_physical_page = get_page(task_directory, (void*) first_page) & 0xfffff000;
+
+    uint32_t page = first_page;
+    for (; page < start + size; page += PAGE_SIZE) {
+        uint32_t entry = get_page(task_directory, (void*) page);
+        if ((entry & required_flags) != required_flags) {
+            break;
+        }
+
+        if ((entry & 0xfffff000) != first_physical_page + (page - first_page)) {
+            break;
+        }
+
+        // last page of address space
+        if (page + PAGE_SIZE < page) {
+            page = start + size;
+            break;
+        }
+    }
+
+    if (page == first_page) {
+        return 0;
+    }
+
+    uint32_t end = page < start + size ? page : start + size;
+    *chunk_size = end - start;
+    return convert_virtual_address_to_physical(task, virtual_address);
+}
+
 void run_next_task() {
     struct task* next_task = get_next_task();
     if (!next_task) {
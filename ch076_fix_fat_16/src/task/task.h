@@ -59,6 +59,9 @@ int copy_string_from_task(struct task* task, void* virtual_address, void* physic
 void* get_task_stack_item(struct task* task, int index);
 
 void* convert_virtual_address_to_physical(struct task* task, void* virtual_address);
+void* get_task_writable_buffer(struct task* task, void* virtual_address, uint32_t size);
+void* get_task_writable_chunk(struct task* task, void* virtual_address, uint32_t size, uint32_t* chunk_size);
+void* get_task_readable_chunk(struct task* task, void* virtual_address, uint32_t size, uint32_t* chunk_size);
 
 void run_next_task();
 
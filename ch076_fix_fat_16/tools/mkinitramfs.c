@@ -0,0 +1,84 @@
+// Host tool, packs files into initramfs image: mkinitramfs <output> <file>...
+// Each file goes to root directory under its own name
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "fs/ramfs/initramfs.h"
+
+static const char* get_base_name(const char* path) {
+    const char* base_name = strrchr(path, '/');
+    return base_name ? base_name + 1 : path;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s <output> <file>...\n", argv[0]);
+        return 1;
+    }
+
+    uint32_t total_entries = argc - 2;
+    struct initramfs_header header = {
+        .signature = INITRAMFS_SIGNATURE,
+        .total_entries = total_entries,
+    };
+    struct initramfs_entry* entries = calloc(total_entries ? total_entries : 1, sizeof(struct initramfs_entry));
+    char** file_data = calloc(total_entries ? total_entries : 1, sizeof(char*));
+
+    // file data starts right after entry table, every file 4 bytes aligned
+    uint32_t offset = sizeof(header) + total_entries * sizeof(struct initramfs_entry);
+    for (uint32_t i = 0; i < total_entries; i++) {
+        const char* path = argv[i + 2];
+        const char* name = get_base_name(path);
+        if (strlen(name) >= INITRAMFS_NAME_LENGTH) {
+            fprintf(stderr, "%s: name too long\n", path);
+            return 1;
+        }
+
+        FILE* file = fopen(path, "rb");
+        if (!file) {
+            perror(path);
+            return 1;
+        }
+
+        fseek(file, 0, SEEK_END);
+        long size = ftell(file);
+        fseek(file, 0, SEEK_SET);
+        file_data[i] = malloc(size ? size : 1);
+        if (fread(file_data[i], 1, size, file) != (size_t) size) {
+            perror(path);
+            return 1;
+        }
+        fclose(file);
+
+        strcpy(entries[i].name, name);
+        entries[i].offset = offset;
+        entries[i].size = size;
+        offset = (offset + size + 3) & ~3;
+    }
+
+    header.total_size = offset;
+    if (header.total_size > INITRAMFS_MAX_SIZE) {
+        fprintf(stderr, "image takes %u bytes, at most %u fit before FAT area\n", header.total_size, INITRAMFS_MAX_SIZE);
+        return 1;
+    }
+
+    FILE* output = fopen(argv[1], "wb");
+    if (!output) {
+        perror(argv[1]);
+        return 1;
+    }
+
+    fwrite(&header, sizeof(header), 1, output);
+    fwrite(entries, sizeof(struct initramfs_entry), total_entries, output);
+    for (uint32_t i = 0; i < total_entries; i++) {
+        fseek(output, entries[i].offset, SEEK_SET);
+        fwrite(file_data[i], 1, entries[i].size, output);
+    }
+
+    // pad last file up to total size
+    for (long position = ftell(output); position < header.total_size; position++) {
+        fputc(0, output);
+    }
+    fclose(output);
+    return 0;
+}